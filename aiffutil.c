@@ -0,0 +1,731 @@
+/* Author: Seth George */
+
+#include "aiffutil.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_KERNELS /* SSE2/SSSE3/AVX2 kernels, picked at run time by what the CPU supports */
+#include <immintrin.h>
+#endif
+
+/**
+*	Parse files of AIFF format
+*/
+void parseAiff(soundfile_t *snd){
+	parseAiffChunks(snd, AIFF_PARSE);
+}
+
+/**
+*	Read only the header information of an AIFF file, seeking past the sample data
+*/
+void probeAiff(soundfile_t *snd){
+	parseAiffChunks(snd, AIFF_PROBE);
+}
+
+/**
+*	Walk the chunks of an AIFF file. With AIFF_PROBE, SSND is skipped rather than decoded.
+*	With AIFF_STREAM, the stream is left at the start of the sample data if COMM came before SSND, and 1 is returned,
+*	otherwise the file is parsed like AIFF_PARSE and 0 is returned
+*/
+int parseAiffChunks(soundfile_t *snd, int mode){
+	char buf[4];
+	int remaining = bytesToInt(snd->stream, 4); /* get the size of the file */
+	
+	fread(buf, 1,  4, snd->stream); /*take in AIFF */
+	if(feof(snd->stream)){ /* check if end of file */
+		sndFail(SND_ERR_FORMAT, "found end of file before was specified\n");
+	}
+	if(strncmp(buf, "AIFF", 4) > 0){ /* check that the next 4 bytes are "AIFF" */
+		sndFail(SND_ERR_FORMAT, "AIFF not found, invalid format\n");
+	}
+	remaining -= 4;
+	
+	char *storage = NULL; /* Set sound data to null before stuff is put into it, for error checking */
+	int chunkSize;
+	int dataSize;
+	int commFlag = 0;
+	int ssndFlag = 0;
+	while(remaining > 0){ /* while there are bytes remaining */
+		fread(buf, 1,  4, snd->stream); /* read 4 bytes for ID */
+		if(feof(snd->stream)){ /* check if end of file */
+			sndFail(SND_ERR_FORMAT, "found end of file before was specified\n");
+		}
+		remaining -= 4;
+		
+		chunkSize = bytesToInt(snd->stream, 4);
+		if(chunkSize % 2 == 1){ /* add 1 byte to this number if it is odd */
+			chunkSize++;
+		}
+		remaining -= 4;
+		
+		if(strncmp(buf, "COMM", 4) == 0){ /* check that the next 4 bytes are "COMM" */
+			if(commFlag == 1){
+				sndFail(SND_ERR_FORMAT, "duplicate COMM data block found\n");
+			}
+			commFlag = 1;
+			parseComm(snd, chunkSize); /* read stuff and then skip to end of chunk */
+			
+		} else if(strncmp(buf, "SSND", 4) == 0){ /* check that the next 4 bytes are "SSND" */ 
+			if(ssndFlag == 1){
+				sndFail(SND_ERR_FORMAT, "duplicate SSND data block found\n");
+			}
+			ssndFlag = 1;
+			if(mode == AIFF_STREAM && commFlag){ /* the caller reads the sample data */
+				snd->offset = bytesToInt(snd->stream, 4);
+				snd->blockSize = bytesToInt(snd->stream, 4);
+				snd->numBytes = chunkSize - (snd->offset + snd->blockSize + 8);
+				skipBytes(snd->stream, snd->offset);
+				checkSampleSize(snd);
+				return 1;
+			} else if(mode == AIFF_PROBE){
+				probeSsnd(snd, chunkSize); /* only take the sizes, then skip to end of chunk */
+			} else {
+				parseSsnd(snd, chunkSize, &storage); /* read stuff and then skip to end of chunk */
+			}
+			
+		} else {
+			skipBytes(snd->stream, chunkSize); /* skip the whole chunk */
+		}
+		remaining -= chunkSize;
+	}
+	if(commFlag == 0 || ssndFlag == 0){ /* check is missing necessary chunk */
+		sndFail(SND_ERR_FORMAT, "necessary data block not found: %s%s\n", commFlag ? "" : "COMM ", ssndFlag ? "" : "SSND ");
+	}
+	
+	if(mode == AIFF_PROBE){
+		checkSampleSize(snd);
+	} else if(snd->samples){ /* samples my be 0 */
+		checkSamples(snd, &storage);
+	}
+	return 0;
+}
+
+/**
+*	Parse the COMM chunk of AIFF files
+*/
+void parseComm(soundfile_t *snd, int chunkSize){	
+	snd->channels = bytesToInt(snd->stream, 2); /* NumChannels (2 bytes) */
+	chunkSize -= 2;
+	snd->samples = bytesToInt(snd->stream, 4); /* NumSampleFrames (4 bytes, unsigned) */
+	chunkSize -= 4;
+	snd->bitDepth = bytesToInt(snd->stream, 2); /* SampleSize (2 bytes) */
+	chunkSize -= 2;
+	snd->sampleRate = floatToLong(snd->stream); /* SampleRate (10 bytes) */
+	chunkSize -= 10;
+	
+	skipBytes(snd->stream, chunkSize); /* skip rest  block size */
+}
+
+/**
+*	Parse the SSND chunk of AIFF files
+*/
+void parseSsnd(soundfile_t *snd, int chunkSize, char **storage){
+	int offset = bytesToInt(snd->stream, 4); /* Offset (4 bytes, unsigned) */
+	int blockSize = bytesToInt(snd->stream, 4); /* Block Size (4 bytes, unsigned) */
+	chunkSize -= (offset + blockSize + 8);
+	
+	skipBytes(snd->stream, offset);/* skip offset */
+
+	*storage = malloc(chunkSize);
+	snd->numBytes = chunkSize;
+	fread(*storage, 1, chunkSize, snd->stream); /* store the sound data to be read after file is parsed */
+	if(feof(snd->stream)){
+		sndFail(SND_ERR_DATA, "found end of file before was specified\n");
+	}
+	
+	skipBytes(snd->stream, blockSize); /* skip block size to align block */
+}
+
+/**
+*	Take the sizes from the SSND chunk of AIFF files without reading the sample data
+*/
+void probeSsnd(soundfile_t *snd, int chunkSize){
+	int offset = bytesToInt(snd->stream, 4); /* Offset (4 bytes, unsigned) */
+	int blockSize = bytesToInt(snd->stream, 4); /* Block Size (4 bytes, unsigned) */
+	
+	snd->offset = offset;
+	snd->blockSize = blockSize;
+	snd->numBytes = chunkSize - (offset + blockSize + 8);
+	snd->dataStart = ftell(snd->stream) + offset; /* where the sample data begins, if the stream can seek */
+	skipBytes(snd->stream, chunkSize - 8); /* seek past offset, sample data and block alignment */
+}
+
+/**
+*	Memory maps an AIFF file so the big-endian sample data can be used in place.
+*	The header is read from the stream, which must be just past FORM.
+*	Returns 0 without reading anything if the stream is not a regular file
+*/
+int mapAiff(soundfile_t *snd){
+	struct stat info;
+	if(fstat(fileno(snd->stream), &info) != 0 || !S_ISREG(info.st_mode) || info.st_size == 0){
+		return 0;
+	}
+	
+	probeAiff(snd); /* seeks past SSND, leaving where its sample data starts */
+	snd->mappedSize = info.st_size;
+	snd->mapped = mmap(NULL, snd->mappedSize, PROT_READ, MAP_PRIVATE, fileno(snd->stream), 0);
+	if(snd->mapped == MAP_FAILED){
+		sndFail(SND_ERR_IO, "could not memory map the file\n");
+	}
+	if(snd->dataStart + snd->numBytes > snd->mappedSize){
+		sndFail(SND_ERR_DATA, "found end of file before was specified\n");
+	}
+	madvise(snd->mapped, snd->mappedSize, MADV_SEQUENTIAL); /* readers mostly go front to back */
+	
+	snd->ssnd = snd->mapped + snd->dataStart;
+	statsMapped(snd->numBytes); /* its samples are read without read calls */
+	return 1;
+}
+
+/**
+*	Releases the mapping made by mapAiff, and the blocks decoded from it
+*/
+void unmapAiff(soundfile_t *snd){
+	if(snd->mapped){
+		munmap(snd->mapped, snd->mappedSize);
+		dropBlocks(sharedCache(), snd->id);
+		snd->mapped = NULL;
+		snd->ssnd = NULL;
+	}
+}
+
+/**
+*	Decodes numFrames frames of the mapped sample data, starting at frame, into to
+*/
+void decodeFrames(soundfile_t *snd, int frame, int numFrames, void *to){
+	int bytes = snd->bitDepth/8;
+	const unsigned char *from = snd->ssnd + (long)frame * snd->channels * bytes;
+	decodeSamples(from, to, numFrames * snd->channels, snd->bitDepth);
+}
+
+/**
+*	Writes the mapped sound data to an AIFF file without the frames in any [low..high] range.
+*	The kept sample data is copied straight from the mapping, never decoded. The ranges must be merged by mergeRanges
+*/
+void cutMappedAiff(int low[], int high[], int numRestrictions, soundfile_t *snd, FILE *to){
+	int frameBytes = snd->channels * snd->bitDepth/8;
+	
+	soundfile_t out = *snd;
+	out.samples = keptFrames(low, high, numRestrictions, snd->samples);
+	writeAiffHeader(&out, to);
+	
+	int range = 0;
+	int start, spanEnd;
+	for(start = keptSpan(0, snd->samples, low, high, numRestrictions, &range, &spanEnd); start < snd->samples;
+			start = keptSpan(spanEnd, snd->samples, low, high, numRestrictions, &range, &spanEnd)){
+		fwrite(snd->ssnd + (long)start * frameBytes, frameBytes, spanEnd - start, to); /* each kept run in one go */
+	}
+}
+
+/**
+*	Writes the AIFF file with the [low..high] ranges removed, reading its sample data a block at a time.
+*	snd->stream must be at the start of the sample data, as left by parseAiffChunks with AIFF_STREAM.
+*	The ranges must be merged by mergeRanges
+*/
+void cutAiffStream(int low[], int high[], int numRestrictions, soundfile_t *snd, FILE *to){
+	int frameBytes = snd->channels * snd->bitDepth/8;
+	
+	soundfile_t out = *snd;
+	out.samples = keptFrames(low, high, numRestrictions, snd->samples);
+	writeAiffHeader(&out, to);
+	
+	unsigned char *block = malloc((long)BLOCK_FRAMES * frameBytes);
+	int range = 0;
+	int frame;
+	for(frame = 0; frame < snd->samples; frame += BLOCK_FRAMES){
+		int end = frame + BLOCK_FRAMES;
+		if(end > snd->samples){
+			end = snd->samples;
+		}
+		if(fread(block, frameBytes, end - frame, snd->stream) != end - frame){
+			sndFail(SND_ERR_DATA, "found end of file before was specified\n");
+		}
+		
+		int start, spanEnd;
+		for(start = keptSpan(frame, end, low, high, numRestrictions, &range, &spanEnd); start < end;
+				start = keptSpan(spanEnd, end, low, high, numRestrictions, &range, &spanEnd)){
+			fwrite(block + (long)(start - frame) * frameBytes, frameBytes, spanEnd - start, to);
+		}
+	}
+	free(block);
+}
+
+/**
+*	Reads the next numFrames frames of big-endian sample data from the stream and decodes them into data
+*/
+void readAiffFrames(soundfile_t *snd, void *data, int numFrames){
+	int frameBytes = snd->channels * snd->bitDepth/8;
+	unsigned char *raw = malloc((long)numFrames * frameBytes + 1);
+	if(fread(raw, frameBytes, numFrames, snd->stream) != numFrames){
+		sndFail(SND_ERR_DATA, "found end of file before was specified\n");
+	}
+	decodeSamples(raw, data, numFrames * snd->channels, snd->bitDepth);
+	free(raw);
+}
+
+/**
+*	Check that the size of the SSND sample data matches the COMM chunk
+*/
+void checkSampleSize(soundfile_t *snd){
+	int bytes = snd->bitDepth/8;	
+	int expectedSize = bytes * snd->samples * snd->channels; /* calculate what the size is supposed to be */
+	
+	if(expectedSize != snd->numBytes){ /* if statement checking its the right size */
+		sndFail(SND_ERR_DATA, "number of samples %d does not match expected sample size of %d\n", snd->numBytes, expectedSize);
+	}
+}
+
+/**
+*	Check that all the sound samples in SSND are within bit depth limit
+*/
+void checkSamples(soundfile_t *snd, char **storage){
+	int bytes = snd->bitDepth/8;
+	checkSampleSize(snd);
+	
+	/* every value of a whole number of bytes is within its bit depth, so only decoding is needed */
+	int width = sampleWidth(snd->bitDepth);
+	int count = snd->numBytes/bytes;
+	if(width == bytes){ /* decoded in place, the storage becomes the sample data */
+		decodeSamples((unsigned char *)*storage, *storage, count, snd->bitDepth);
+		snd->sampleData = *storage;
+	} else {
+		snd->sampleData = malloc(count*width);
+		decodeSamples((unsigned char *)*storage, snd->sampleData, count, snd->bitDepth);
+		free(*storage);
+	}
+	*storage = NULL;
+}
+
+/**
+*	check that the given sample is within the right bit depth
+*/
+void checkBitDepth(long long sample, int bitDepth){
+	long long upper = (1LL << (bitDepth -1)) -1; /* 32 bit limits do not fit power's int */
+	long long lower = -(1LL << (bitDepth -1));
+
+	if((sample < lower)||(sample > upper)){ /* check if within bitDepth bounds */
+		sndFail(SND_ERR_DATA, "found sample beyond excepted bit depth limits %lld\n", sample);
+	}
+}
+
+/*==================== Byte Stuff ====================*/
+/**
+*	Read number of bytes as an int
+*/
+int bytesToInt(FILE* stream, int numBytes){
+	char buffer[numBytes];
+	if(fread(buffer, 1, numBytes, stream));
+	if(feof(stream)){
+		sndFail(SND_ERR_FORMAT, "found end of file before was specified\n");
+	}
+	int num = flipEndianness(buffer, numBytes);
+	return num;
+}
+
+/**
+*	Convert int to binary
+*/
+void intToBytes(FILE *stream, int num, int bytes){
+	int i;
+	for(i = (bytes - 1); i >= 0; i--){
+		fputc((num >> (i*8)) & 0xFF, stream);
+	}
+}
+
+/**
+*	Name of the fastest kernel set the CPU supports, for reporting
+*/
+const char *decodeKernel(){
+#ifdef HAVE_X86_KERNELS
+	if(__builtin_cpu_supports("avx2")){
+		return "avx2";
+	} else if(__builtin_cpu_supports("ssse3")){
+		return "ssse3";
+	}
+	return "sse2";
+#else
+	return "scalar";
+#endif
+}
+
+#ifdef HAVE_X86_KERNELS
+/* 
+*	Byte shuffles for the kernels below. A 0x80 lane is zeroed.
+*	swap16 and swap32 reverse each value, unpack24 spreads 4 big-endian 24 bit values
+*	into the top 3 bytes of 4 ints, which an arithmetic shift then sign extends
+*/
+#define SWAP16_MASK 14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1
+#define SWAP32_MASK 12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3
+#define UNPACK24_MASK 9, 10, 11, -128, 6, 7, 8, -128, 3, 4, 5, -128, 0, 1, 2, -128
+
+__attribute__((target("avx2")))
+static int swap16Avx2(const uint16_t *in, uint16_t *out, int count){
+	__m256i mask = _mm256_set_epi8(SWAP16_MASK, SWAP16_MASK);
+	int i = 0;
+	for(; i + 16 <= count; i += 16){
+		__m256i v = _mm256_loadu_si256((const __m256i *)(in + i));
+		_mm256_storeu_si256((__m256i *)(out + i), _mm256_shuffle_epi8(v, mask));
+	}
+	return i;
+}
+
+__attribute__((target("sse2")))
+static int swap16Sse2(const uint16_t *in, uint16_t *out, int count){
+	int i = 0;
+	for(; i + 8 <= count; i += 8){ /* swapping the bytes of 16 bit values is two shifts */
+		__m128i v = _mm_loadu_si128((const __m128i *)(in + i));
+		v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+		_mm_storeu_si128((__m128i *)(out + i), v);
+	}
+	return i;
+}
+
+__attribute__((target("avx2")))
+static int swap32Avx2(const uint32_t *in, uint32_t *out, int count){
+	__m256i mask = _mm256_set_epi8(SWAP32_MASK, SWAP32_MASK);
+	int i = 0;
+	for(; i + 8 <= count; i += 8){
+		__m256i v = _mm256_loadu_si256((const __m256i *)(in + i));
+		_mm256_storeu_si256((__m256i *)(out + i), _mm256_shuffle_epi8(v, mask));
+	}
+	return i;
+}
+
+__attribute__((target("ssse3")))
+static int swap32Ssse3(const uint32_t *in, uint32_t *out, int count){
+	__m128i mask = _mm_set_epi8(SWAP32_MASK);
+	int i = 0;
+	for(; i + 4 <= count; i += 4){
+		__m128i v = _mm_loadu_si128((const __m128i *)(in + i));
+		_mm_storeu_si128((__m128i *)(out + i), _mm_shuffle_epi8(v, mask));
+	}
+	return i;
+}
+
+__attribute__((target("sse2")))
+static int swap32Sse2(const uint32_t *in, uint32_t *out, int count){
+	int i = 0;
+	for(; i + 4 <= count; i += 4){ /* swap the 16 bit halves, then the bytes in each half */
+		__m128i v = _mm_loadu_si128((const __m128i *)(in + i));
+		v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+		v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+		_mm_storeu_si128((__m128i *)(out + i), v);
+	}
+	return i;
+}
+
+__attribute__((target("avx2")))
+static int unpack24Avx2(const unsigned char *in, int32_t *out, int count){
+	__m256i mask = _mm256_set_epi8(UNPACK24_MASK, UNPACK24_MASK);
+	int i = 0;
+	for(; i + 12 <= count; i += 8){ /* each half loads 16 bytes for 12, so stop while 4 more values remain */
+		__m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)(in + i*3))),
+			_mm_loadu_si128((const __m128i *)(in + i*3 + 12)), 1);
+		v = _mm256_srai_epi32(_mm256_shuffle_epi8(v, mask), 8);
+		_mm256_storeu_si256((__m256i *)(out + i), v);
+	}
+	return i;
+}
+
+__attribute__((target("ssse3")))
+static int unpack24Ssse3(const unsigned char *in, int32_t *out, int count){
+	__m128i mask = _mm_set_epi8(UNPACK24_MASK);
+	int i = 0;
+	for(; i + 6 <= count; i += 4){ /* loads 16 bytes for 12, so stop while 2 more values remain */
+		__m128i v = _mm_loadu_si128((const __m128i *)(in + i*3));
+		v = _mm_srai_epi32(_mm_shuffle_epi8(v, mask), 8);
+		_mm_storeu_si128((__m128i *)(out + i), v);
+	}
+	return i;
+}
+#endif
+
+/**
+*	Reverse the byte order of count 16 bit values from from into to, which may be the same
+*/
+void swapBytes16(const void *from, void *to, int count){
+	const uint16_t *in = from;
+	uint16_t *out = to;
+	int i = 0;
+#ifdef HAVE_X86_KERNELS
+	if(__builtin_cpu_supports("avx2")){
+		i = swap16Avx2(in, out, count);
+	} else {
+		i = swap16Sse2(in, out, count);
+	}
+#endif
+	for(; i < count; i++){
+		out[i] = __builtin_bswap16(in[i]);
+	}
+}
+
+/**
+*	Reverse the byte order of count 32 bit values from from into to, which may be the same
+*/
+void swapBytes32(const void *from, void *to, int count){
+	const uint32_t *in = from;
+	uint32_t *out = to;
+	int i = 0;
+#ifdef HAVE_X86_KERNELS
+	if(__builtin_cpu_supports("avx2")){
+		i = swap32Avx2(in, out, count);
+	} else if(__builtin_cpu_supports("ssse3")){
+		i = swap32Ssse3(in, out, count);
+	} else {
+		i = swap32Sse2(in, out, count);
+	}
+#endif
+	for(; i < count; i++){
+		out[i] = __builtin_bswap32(in[i]);
+	}
+}
+
+/**
+*	Sign extend count big-endian 24 bit values from from into ints
+*/
+void unpackBytes24(const unsigned char *from, int32_t *to, int count){
+	int i = 0;
+#ifdef HAVE_X86_KERNELS
+	if(__builtin_cpu_supports("avx2")){
+		i = unpack24Avx2(from, to, count);
+	} else if(__builtin_cpu_supports("ssse3")){
+		i = unpack24Ssse3(from, to, count);
+	}
+#endif
+	for(; i < count; i++){
+		const unsigned char *at = from + i*3;
+		to[i] = (int32_t)(((uint32_t)at[0] << 24) | (at[1] << 16) | (at[2] << 8)) >> 8;
+	}
+}
+
+/**
+*	Decode count big-endian samples of the bit depth into native width sample data.
+*	from and to may be the same when the bit depth is a whole 1, 2 or 4 bytes
+*/
+void decodeSamples(const unsigned char *from, void *to, int count, int bitDepth){
+	int bytes = bitDepth/8;
+	int width = sampleWidth(bitDepth);
+	int i;
+	int j;
+	
+	if(bytes == 1 && width == 1){
+		memmove(to, from, count); /* signed bytes need no decoding */
+	} else if(bytes == 2 && width == 2){
+		swapBytes16(from, to, count);
+	} else if(bytes == 4 && width == 4){
+		swapBytes32(from, to, count);
+	} else if(bytes == 3 && width == 4){
+		unpackBytes24(from, to, count);
+	} else { /* anything else, the first byte carries the sign */
+		for(i = 0; i < count; i++){
+			int value = (signed char)from[0];
+			for(j = 1; j < bytes; j++){
+				value = (value << 8) | from[j];
+			}
+			writeSample(to, width, i, value);
+			from += bytes;
+		}
+	}
+}
+
+/**
+*	Read number of bytes as a long
+*/
+unsigned long floatToLong(FILE* stream){
+	unsigned char buffer[10];
+	fread(buffer, 1,  10, stream);
+	if(feof(stream)){
+		sndFail(SND_ERR_FORMAT, "found end of file before was specified\n");
+	}
+	unsigned long num = ConvertFloat(buffer);
+	return num;
+}
+
+/**
+*	Flip bytes to opposing endianness
+*/
+int flipEndianness(char* buffer, int numBytes){
+	char* flip = calloc(1, 4);
+	int i;
+	for(i = 0; i < numBytes; i++){
+		flip[i] =  buffer[numBytes -i -1];
+	}
+	int val = *((int*)flip);
+
+	free(flip);
+	return val;
+}
+
+/***************************** FlipLong() ******************************
+ * Converts a long in "Big Endian" format (ie, Motorola 68000) to Intel
+ * reverse-byte format, or vice versa if originally in Big Endian.
+ ********************************************************************* */
+void FlipLong(unsigned char * ptr){
+   register unsigned char val;
+
+   /* Swap 1st and 4th bytes */
+   val = *(ptr);
+   *(ptr) = *(ptr+3);
+   *(ptr+3) = val;
+
+   /* Swap 2nd and 3rd bytes */
+   ptr += 1;
+   val = *(ptr);
+   *(ptr) = *(ptr+1);
+   *(ptr+1) = val;
+}
+
+/*************************** FetchLong() *******************************
+ * Fools the compiler into fetching a long from a char array.
+ ********************************************************************* */
+unsigned long FetchLong(unsigned long * ptr){
+   return(*ptr);
+}
+
+/*************************** ConvertFloat() *****************************
+ * Converts an 80 bit IEEE Standard 754 floating point number to an unsigned
+ * long.
+ ********************************************************************** */
+unsigned long ConvertFloat(unsigned char * buffer){
+   unsigned long mantissa;
+   unsigned long last = 0;
+   unsigned char exp;
+
+   FlipLong((unsigned long*)(buffer+2));
+
+   mantissa = FetchLong((unsigned long *)(buffer+2));
+   exp = 30 - *(buffer+1);
+   while (exp--)
+   {
+	 last = mantissa;
+	 mantissa >>= 1;
+   }
+   if (last & 0x00000001) mantissa++;
+   return(mantissa);
+}
+
+/*************************** StoreLong() ******************************
+ * Fools the compiler into storing a long into a char array.
+ ******************************************************************** */
+void StoreLong(unsigned long val, unsigned long * ptr)
+{
+   *ptr = val;
+}
+
+/**************************** StoreFloat() ******************************
+ * Converts an unsigned long to 80 bit IEEE Standard 754 floating point
+ * number.
+ ********************************************************************** */
+void StoreFloat(unsigned char * buffer, unsigned long value)
+{
+   unsigned long exp;
+   unsigned char i;
+
+   memset(buffer, 0, 10);
+
+   exp = value;
+   exp >>= 1;
+   for (i=0; i<32; i++) { exp>>= 1;
+	  if (!exp) break;
+   }
+   *(buffer+1) = i;
+
+   for (i=32; i; i--){
+	  if (value & 0x80000000) break;
+	  value <<= 1;
+	}
+	StoreLong(value, buffer+2);
+	FlipLong((unsigned long *)(buffer+2));
+} 
+
+/**
+*	Write an Aiff file from a CS229 file
+*/
+void writeAiff(soundfile_t *from, FILE *to){
+	writeAiffHeader(from, to);
+	
+	int block;
+	int numBlocks = (from->samples + BLOCK_FRAMES - 1) / BLOCK_FRAMES;
+	for(block = 0; block < numBlocks; block++){ /* release samples */
+		int numFrames = from->samples - block*BLOCK_FRAMES;
+		if(numFrames > BLOCK_FRAMES){
+			numFrames = BLOCK_FRAMES;
+		}
+		writeAiffFrames(from, frameBlock(from, block), numFrames, to);
+	}
+}
+
+/**
+*	Write numFrames frames of AIFF sample data. The samples are encoded big-endian
+*	into a WRITE_BLOCK buffer, which is written in one go when full
+*/
+void writeAiffFrames(soundfile_t *from, const void *data, int numFrames, FILE *to){
+	int bytes = from->bitDepth/8;
+	int width = sampleWidth(from->bitDepth);
+	int count = numFrames * from->channels;
+	int perBlock = WRITE_BLOCK / bytes; /* samples that fit in the buffer */
+	unsigned char *buffer = malloc(WRITE_BLOCK);
+	const char *samples = data;
+	int i;
+	int j;
+	
+	if(bytes == 1 && width == 1){ /* 8 bit samples are already single bytes */
+		fwrite(data, 1, count, to);
+		free(buffer);
+		return;
+	}
+	
+	while(count > 0){
+		int chunk = count < perBlock ? count : perBlock;
+		if(bytes == 2 && width == 2){
+			swapBytes16(samples, buffer, chunk);
+		} else if(bytes == 4 && width == 4){
+			swapBytes32(samples, buffer, chunk);
+		} else { /* 24 bit and other odd sizes, most significant byte first */
+			unsigned char *at = buffer;
+			for(i = 0; i < chunk; i++){
+				int value = readSample(samples, width, i);
+				for(j = bytes - 1; j >= 0; j--){
+					*at++ = (value >> (j*8)) & 0xFF;
+				}
+			}
+		}
+		fwrite(buffer, bytes, chunk, to);
+		samples += chunk * width;
+		count -= chunk;
+	}
+	free(buffer);
+}
+
+/**
+*	Write everything of an Aiff file up to the sample data, sized for from->samples
+*/
+void writeAiffHeader(soundfile_t *from, FILE *to){
+	int bytes = from->bitDepth/8;
+	int blockSize = 0;
+	int commSize = 18;
+	int ssndSize = (from->samples * from->channels * bytes) + 8;
+	if(ssndSize%2){
+		ssndSize++;
+		blockSize = 1;
+	}
+
+	fwrite("FORM", 4, 1, to); /* write FORM */
+	int fileSize = commSize + ssndSize + 20;
+	intToBytes(to, fileSize, 4); /* write remaining bytes in file */
+	fwrite("AIFF", 4, 1, to);/* write AIFF*/
+	
+	fwrite("COMM", 4, 1, to); /* write COMM */
+	intToBytes(to, commSize, 4); /* bytes left in chunk */
+	intToBytes(to, from->channels, 2); /* NumChannels */
+	intToBytes(to, from->samples, 4); /* NumSampleFrames */
+	intToBytes(to, from->bitDepth, 2); /* SampleSize */
+	char sampleRate[10]; /* SampleRate */
+	StoreFloat(sampleRate, from->sampleRate); /* extended precision floating point */
+	fwrite(sampleRate, 10, 1, to);
+	
+	fwrite("SSND", 4, 1, to); /* write SSND */
+	intToBytes(to, ssndSize, 4); /* bytes left in chunk */
+	intToBytes(to, 0, 4); /* Offset */
+	intToBytes(to, blockSize, 4); /* BlockSize */
+}
\ No newline at end of file
@@ -0,0 +1,49 @@
+/* Author: Seth George */
+
+#ifndef AIFFUTIL_H
+#define AIFFUTIL_H
+
+#include "sndutil.h"
+
+#define AIFF_PARSE 0 /* parseAiffChunks reads and decodes the sample data */
+#define AIFF_PROBE 1 /* parseAiffChunks skips the sample data */
+#define AIFF_STREAM 2 /* parseAiffChunks stops at the start of the sample data */
+
+/* Parsing AIFF Functions */
+void parseAiff(soundfile_t *snd);
+void probeAiff(soundfile_t *snd);
+int parseAiffChunks(soundfile_t *snd, int mode);
+void parseComm(soundfile_t *snd, int chunkSize);
+void parseSsnd(soundfile_t *snd, int chunkSize, char **storage);
+void probeSsnd(soundfile_t *snd, int chunkSize);
+void checkSampleSize(soundfile_t *snd);
+void checkSamples(soundfile_t *snd, char** storage);
+void checkBitDepth(long long sample, int bitDepth);
+
+/* Memory Mapped AIFF Functions */
+int mapAiff(soundfile_t *snd);
+void unmapAiff(soundfile_t *snd);
+void decodeFrames(soundfile_t *snd, int frame, int numFrames, void *to);
+void cutMappedAiff(int low[], int high[], int numRestrictions, soundfile_t *snd, FILE *to);
+void cutAiffStream(int low[], int high[], int numRestrictions, soundfile_t *snd, FILE *to);
+void readAiffFrames(soundfile_t *snd, void *data, int numFrames);
+
+/* Byte Stuff */
+void intToBytes(FILE *stream, int num, int bytes);
+int bytesToInt(FILE* stream, int numBytes);
+unsigned long floatToLong(FILE* stream);
+int flipEndianness(char *buffer, int numBytes);
+void swapBytes16(const void *from, void *to, int count);
+void swapBytes32(const void *from, void *to, int count);
+void unpackBytes24(const unsigned char *from, int32_t *to, int count);
+void decodeSamples(const unsigned char *from, void *to, int count, int bitDepth);
+const char *decodeKernel();
+void FlipLong(unsigned char *ptr);
+unsigned long FetchLong(unsigned long *ptr);
+unsigned long ConvertFloat(unsigned char *buffer);
+
+void writeAiff(soundfile_t *from, FILE* to);
+void writeAiffHeader(soundfile_t *from, FILE *to);
+void writeAiffFrames(soundfile_t *from, const void *data, int numFrames, FILE *to);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,194 @@
+/* Author: Seth George */
+
+#include "allocutil.h"
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *data, size_t size);
+void __real_free(void *data);
+
+void *defaultMalloc(size_t size, void *arg){
+	(void)arg;
+	return __real_malloc(size);
+}
+
+void *defaultRealloc(void *data, size_t size, void *arg){
+	(void)arg;
+	return __real_realloc(data, size);
+}
+
+void defaultFree(void *data, void *arg){
+	(void)arg;
+	__real_free(data);
+}
+
+/**
+*	Starts a context with nothing allocated, using allocator or the C library's malloc if it is NULL
+*/
+void initContext(sndcontext_t *context, const sndallocator_t *allocator){
+	if(allocator){
+		context->allocator = *allocator;
+	} else {
+		context->allocator.malloc = defaultMalloc;
+		context->allocator.realloc = defaultRealloc;
+		context->allocator.free = defaultFree;
+		context->allocator.arg = NULL;
+	}
+	context->newest = NULL;
+	context->previous = NULL;
+	context->message[0] = '\0';
+	context->length = 0;
+	context->out = stderr;
+	context->newline = 0;
+}
+
+/**
+*	Frees everything allocated for the context
+*/
+void freeContext(sndcontext_t *context){
+	while(context->newest){
+		contextFree(context->newest);
+	}
+}
+
+/**
+*	Adds an allocation to the front of its context's list
+*/
+void linkAllocation(allocation_t *block){
+	sndcontext_t *context = block->context;
+	block->newer = NULL;
+	block->older = context->newest;
+	if(context->newest){
+		context->newest->newer = block;
+	}
+	context->newest = block;
+}
+
+/**
+*	Takes an allocation out of its context's list
+*/
+void unlinkAllocation(allocation_t *block){
+	if(block->newer){
+		block->newer->older = block->older;
+	} else {
+		block->context->newest = block->older;
+	}
+	if(block->older){
+		block->older->newer = block->newer;
+	}
+}
+
+/**
+*	Returns the header of data if it was allocated for the context, or NULL if the memory came from elsewhere.
+*	Only the context's own list is searched, the memory before data is never read, as it may not be the context's.
+*	The newest are looked at first, as they are the most often freed
+*/
+allocation_t *allocationOf(sndcontext_t *context, void *data){
+	allocation_t *block;
+	for(block = context->newest; block; block = block->older){
+		if((char *)block + ALLOCATION_HEADER == (char *)data){
+			return block;
+		}
+	}
+	return NULL;
+}
+
+/**
+*	Allocates size bytes for the context, moving data into them if it is not NULL, like realloc.
+*	data must have been allocated for the context. Fails with SND_ERR_MEMORY, leaving data as it was, if the allocator runs out
+*/
+void *contextAlloc(sndcontext_t *context, void *data, size_t size){
+	sndcontext_t *active = activeContext;
+	allocation_t *old = data ? allocationOf(context, data) : NULL;
+	allocation_t *block;
+	if(old){ /* realloc moves it, so it is out of the list until it is in its new place */
+		unlinkAllocation(old);
+	}
+	
+	sndallocator_t *allocator = &context->allocator;
+	activeContext = NULL; /* the allocator may itself call malloc */
+	if(old && allocator->realloc){
+		block = allocator->realloc(old, ALLOCATION_HEADER + size, allocator->arg);
+	} else {
+		block = allocator->malloc(ALLOCATION_HEADER + size, allocator->arg);
+		if(block && old){
+			memcpy((char *)block + ALLOCATION_HEADER, data, (old->size < size) ? old->size : size);
+			allocator->free(old, allocator->arg);
+		}
+	}
+	activeContext = active;
+	if(!block){
+		if(old){
+			linkAllocation(old);
+		}
+		sndFail(SND_ERR_MEMORY, "error allocating memory for sample data.\n");
+	}
+	
+	block->context = context;
+	block->size = size;
+	linkAllocation(block);
+	return (char *)block + ALLOCATION_HEADER;
+}
+
+/**
+*	Frees an allocation made by contextAlloc, back to the allocator of the context it was allocated for
+*/
+void contextFree(allocation_t *block){
+	sndallocator_t *allocator = &block->context->allocator;
+	sndcontext_t *active = activeContext;
+	unlinkAllocation(block);
+	activeContext = NULL;
+	allocator->free(block, allocator->arg);
+	activeContext = active;
+}
+
+/**
+*	Counts the program's allocations for --stats. The programs with --stats and the library are linked with --wrap=malloc,
+*	--wrap=calloc, --wrap=realloc and --wrap=free, so their calls come here first. Threads may allocate at once.
+*	While a library call is running the memory comes from its handle's allocator instead,
+*	and memory is only handed back to that allocator if it is on the handle's list
+*/
+void *__wrap_malloc(size_t size){
+	if(stats.on){
+		__atomic_add_fetch(&stats.allocations, 1, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&stats.allocated, (long)size, __ATOMIC_RELAXED);
+	}
+	if(activeContext){
+		return contextAlloc(activeContext, NULL, size);
+	}
+	return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size){
+	if(stats.on){
+		__atomic_add_fetch(&stats.allocations, 1, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&stats.allocated, (long)(count * size), __ATOMIC_RELAXED);
+	}
+	if(activeContext){
+		if(size && count > SIZE_MAX / size){ /* count * size would wrap, where the C library's calloc fails */
+			sndFail(SND_ERR_MEMORY, "error allocating memory for sample data.\n");
+		}
+		return memset(contextAlloc(activeContext, NULL, count * size), 0, count * size);
+	}
+	return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *data, size_t size){
+	if(stats.on){
+		__atomic_add_fetch(&stats.allocations, 1, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&stats.allocated, (long)size, __ATOMIC_RELAXED);
+	}
+	if(activeContext && (!data || allocationOf(activeContext, data))){
+		return contextAlloc(activeContext, data, size);
+	}
+	return __real_realloc(data, size);
+}
+
+void __wrap_free(void *data){
+	allocation_t *block = (data && activeContext) ? allocationOf(activeContext, data) : NULL;
+	if(block){
+		contextFree(block);
+	} else {
+		__real_free(data);
+	}
+}
@@ -0,0 +1,17 @@
+/* Author: Seth George */
+
+#ifndef ALLOCUTIL_H
+#define ALLOCUTIL_H
+
+#include "sndutil.h"
+
+/* Library Allocation Functions */
+void initContext(sndcontext_t *context, const sndallocator_t *allocator);
+void freeContext(sndcontext_t *context);
+void linkAllocation(allocation_t *block);
+void unlinkAllocation(allocation_t *block);
+allocation_t *allocationOf(sndcontext_t *context, void *data);
+void *contextAlloc(sndcontext_t *context, void *data, size_t size);
+void contextFree(allocation_t *block);
+
+#endif
@@ -0,0 +1,136 @@
+/* Author: Seth George */
+
+#include "catutil.h"
+#include "sndutil.h"
+#include <pthread.h>
+
+/**
+*	Writes the samples of the named files to the file described by out, in order.
+*	numThreads workers decode the files at the same time, each up to READ_AHEAD blocks ahead of the writer
+*/
+void catParallel(char *names[], int numNames, int numThreads, soundfile_t *out, FILE *to){
+	catpool_t pool;
+	pool.inputs = calloc(numNames, sizeof(catinput_t));
+	if(!pool.inputs){
+		fprintf(stderr, "Error: error allocating memory for the inputs.\n");
+		exit(EXIT_FAILURE);
+	}
+	pool.numInputs = numNames;
+	pool.next = 0;
+	pthread_mutex_init(&pool.lock, NULL);
+	
+	int i;
+	for(i = 0; i < numNames; i++){
+		pool.inputs[i].name = names[i];
+		pool.inputs[i].frameBytes = out->channels * sampleWidth(out->bitDepth);
+		pthread_mutex_init(&pool.inputs[i].lock, NULL);
+		pthread_cond_init(&pool.inputs[i].changed, NULL);
+	}
+	
+	if(numThreads > numNames){
+		numThreads = numNames;
+	}
+	pthread_t *threads = malloc(numThreads * sizeof(pthread_t));
+	if(!threads){
+		fprintf(stderr, "Error: error allocating memory for the workers.\n");
+		exit(EXIT_FAILURE);
+	}
+	for(i = 0; i < numThreads; i++){
+		if(pthread_create(&threads[i], NULL, catWorker, &pool) != 0){
+			fprintf(stderr, "Error: could not start a decoding thread\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	
+	for(i = 0; i < numNames; i++){ /* the inputs are taken in order, so the one being written always has a worker */
+		catinput_t *input = &pool.inputs[i];
+		pthread_mutex_lock(&input->lock);
+		for(;;){
+			while(input->count == 0 && !input->done){
+				pthread_cond_wait(&input->changed, &input->lock);
+			}
+			if(input->count == 0){ /* done, and every block was written */
+				break;
+			}
+			
+			catblock_t block = input->blocks[input->first];
+			input->first = (input->first + 1) % READ_AHEAD;
+			input->count--;
+			pthread_cond_signal(&input->changed); /* there is room for the worker again */
+			pthread_mutex_unlock(&input->lock);
+			
+			writeFrames(out, block.data, block.numFrames, to);
+			free(block.data);
+			pthread_mutex_lock(&input->lock);
+		}
+		pthread_mutex_unlock(&input->lock);
+	}
+	
+	for(i = 0; i < numThreads; i++){
+		pthread_join(threads[i], NULL);
+	}
+	for(i = 0; i < numNames; i++){
+		pthread_mutex_destroy(&pool.inputs[i].lock);
+		pthread_cond_destroy(&pool.inputs[i].changed);
+	}
+	pthread_mutex_destroy(&pool.lock);
+	free(threads);
+	free(pool.inputs);
+}
+
+/**
+*	Takes the next input of the catpool_t arg and decodes it into its queue, until there are none left
+*/
+void *catWorker(void *arg){
+	catpool_t *pool = arg;
+	for(;;){
+		pthread_mutex_lock(&pool->lock);
+		int i = pool->next++;
+		pthread_mutex_unlock(&pool->lock);
+		if(i >= pool->numInputs){
+			return NULL;
+		}
+		
+		catinput_t *input = &pool->inputs[i];
+		soundfile_t snd;
+		initSoundfile(&snd);
+		strcpy(snd.name, input->name);
+		snd.stream = fopen(input->name, "r");
+		if(!snd.stream){ /* it could be opened when probed */
+			fprintf(stderr, "Error: invalid file argument, cannot be opened.\n");
+			exit(EXIT_FAILURE);
+		}
+		setFormat(&snd);
+		readBlocks(&snd, queueBlock, input);
+		fclose(snd.stream);
+		
+		pthread_mutex_lock(&input->lock);
+		input->done = 1;
+		pthread_cond_signal(&input->changed);
+		pthread_mutex_unlock(&input->lock);
+	}
+}
+
+/**
+*	Copies a block from readBlocks into the queue of the catinput_t arg, waiting while the queue is full
+*/
+void queueBlock(void *arg, const void *data, int numFrames){
+	catinput_t *input = arg;
+	void *copy = malloc((long)numFrames * input->frameBytes + 1);
+	if(!copy){
+		fprintf(stderr, "Error: error allocating memory for sample data.\n");
+		exit(EXIT_FAILURE);
+	}
+	memcpy(copy, data, (long)numFrames * input->frameBytes);
+	
+	pthread_mutex_lock(&input->lock);
+	while(input->count == READ_AHEAD){
+		pthread_cond_wait(&input->changed, &input->lock);
+	}
+	catblock_t *block = &input->blocks[(input->first + input->count) % READ_AHEAD];
+	block->data = copy;
+	block->numFrames = numFrames;
+	input->count++;
+	pthread_cond_signal(&input->changed);
+	pthread_mutex_unlock(&input->lock);
+}
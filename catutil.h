@@ -0,0 +1,38 @@
+/* Author: Seth George */
+
+#ifndef CATUTIL_H
+#define CATUTIL_H
+
+#include "sndutil.h"
+#include <pthread.h>
+
+#define READ_AHEAD 8 /* decoded blocks each input may have waiting to be written */
+
+typedef struct {
+	void *data; /* the frames, stored like sampleData */
+	int numFrames;
+} catblock_t;
+
+typedef struct {
+	char *name; /* file to read */
+	int frameBytes; /* bytes of one decoded frame, the same for every input */
+	catblock_t blocks[READ_AHEAD]; /* decoded and waiting to be written, oldest at first */
+	int first;
+	int count; /* blocks waiting */
+	int done; /* every block of the file has been queued */
+	pthread_mutex_t lock;
+	pthread_cond_t changed; /* signalled when a block is queued or taken, or when done is set */
+} catinput_t;
+
+typedef struct {
+	catinput_t *inputs; /* in argument order */
+	int numInputs;
+	int next; /* next input for a worker to take */
+	pthread_mutex_t lock;
+} catpool_t;
+
+void catParallel(char *names[], int numNames, int numThreads, soundfile_t *out, FILE *to);
+void *catWorker(void *arg);
+void queueBlock(void *arg, const void *data, int numFrames);
+
+#endif
@@ -0,0 +1,542 @@
+/* Author: Seth George */
+
+#include "convutil.h"
+#include "aiffutil.h"
+#include "cs229util.h"
+#include <dirent.h>
+#include <errno.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/**
+*	Converts every AIFF and CS229 file under the directory src to the same place under dst, which is made
+*	as needed. Each file is written in the other format unless forceAIFF, forceCS229 or forceCS229B is set,
+*	CS229B in the given coding.
+*	numThreads workers each take tasks from their own queue, and steal from the others when it is empty.
+*	A big file is read by one task, then encoded in CHUNK_FRAMES chunks that any worker can take.
+*	Prints the totals to standard error, and returns 1 if every file was converted
+*/
+int convertTree(char *src, char *dst, int forceAIFF, int forceCS229, int forceCS229B, int coding, int numThreads){
+	struct stat info;
+	if(stat(src, &info) != 0 || !S_ISDIR(info.st_mode)){
+		fprintf(stderr, "Error: %s is not a directory\n", src);
+		exit(EXIT_FAILURE);
+	}
+	
+	convpool_t pool;
+	memset(&pool, 0, sizeof(pool));
+	pool.forceAIFF = forceAIFF;
+	pool.forceCS229 = forceCS229;
+	pool.forceCS229B = forceCS229B;
+	pool.coding = coding;
+	pthread_mutex_init(&pool.idleLock, NULL);
+	pthread_cond_init(&pool.idle, NULL);
+	if((mkdir(dst, 0777) != 0 && errno != EEXIST) || stat(dst, &info) != 0){
+		fprintf(stderr, "Error: could not make directory %s\n", dst);
+		exit(EXIT_FAILURE);
+	}
+	pool.dstDevice = info.st_dev;
+	pool.dstInode = info.st_ino;
+	findSounds(&pool, src, dst);
+	dropCollisions(&pool);
+	qsort(pool.files, pool.numFiles, sizeof(convfile_t *), compareSizes); /* biggest first, so they are not left until the end */
+	
+	struct timespec started;
+	clock_gettime(CLOCK_MONOTONIC, &started);
+	if(numThreads > pool.numFiles){
+		numThreads = pool.numFiles > 0 ? pool.numFiles : 1;
+	}
+	pool.numWorkers = numThreads;
+	pool.queues = calloc(numThreads, sizeof(taskqueue_t));
+	int i;
+	for(i = 0; i < numThreads; i++){
+		pthread_mutex_init(&pool.queues[i].lock, NULL);
+	}
+	for(i = pool.numFiles - 1; i >= 0; i--){ /* dealt out smallest first, as each worker takes its newest task first */
+		pushTask(&pool, i % numThreads, pool.files[i], -1);
+	}
+	
+	pthread_t *threads = malloc(numThreads * sizeof(pthread_t));
+	convworker_t *workers = malloc(numThreads * sizeof(convworker_t));
+	for(i = 0; i < numThreads; i++){
+		workers[i].pool = &pool;
+		workers[i].index = i;
+		if(pthread_create(&threads[i], NULL, convWorker, &workers[i]) != 0){
+			fprintf(stderr, "Error: could not start a converting thread\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	for(i = 0; i < numThreads; i++){
+		pthread_join(threads[i], NULL);
+	}
+	
+	struct timespec finished;
+	clock_gettime(CLOCK_MONOTONIC, &finished);
+	double secs = (finished.tv_sec - started.tv_sec) + (finished.tv_nsec - started.tv_nsec) / 1e9;
+	double megabytes = pool.readBytes / (1024.0 * 1024);
+	fprintf(stderr, "Converted %d of %d files on %d threads in %.2f s: %.1f MB read at %.1f MB/s, %.1f MB written at %.1f MB/s, %.0f frames/s\n",
+		pool.converted, pool.numFiles, numThreads, secs, megabytes, megabytes / secs,
+		pool.writtenBytes / (1024.0 * 1024), pool.writtenBytes / (1024.0 * 1024) / secs, pool.frames / secs);
+	statsFrames(pool.frames);
+	
+	for(i = 0; i < pool.numFiles; i++){
+		pthread_mutex_destroy(&pool.files[i]->lock);
+		free(pool.files[i]);
+	}
+	for(i = 0; i < numThreads; i++){
+		pthread_mutex_destroy(&pool.queues[i].lock);
+		free(pool.queues[i].tasks);
+	}
+	pthread_mutex_destroy(&pool.idleLock);
+	pthread_cond_destroy(&pool.idle);
+	free(pool.files);
+	free(pool.queues);
+	free(threads);
+	free(workers);
+	return pool.failed == 0;
+}
+
+/**
+*	Adds every AIFF and CS229 file under src to the pool, making the directories under dst they are written to.
+*	Files whose paths are too long are reported and counted as failed
+*/
+void findSounds(convpool_t *pool, char *src, char *dst){
+	DIR *dir = opendir(src);
+	if(!dir){
+		fprintf(stderr, "Error: could not open directory %s\n", src);
+		exit(EXIT_FAILURE);
+	}
+	if(mkdir(dst, 0777) != 0 && errno != EEXIST){
+		fprintf(stderr, "Error: could not make directory %s\n", dst);
+		exit(EXIT_FAILURE);
+	}
+	
+	struct dirent *entry;
+	while((entry = readdir(dir)) != NULL){
+		if(strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0){
+			continue;
+		}
+		char path[MAX_PATH_LENGTH];
+		char into[MAX_PATH_LENGTH];
+		struct stat info;
+		if(snprintf(path, sizeof(path), "%s/%s", src, entry->d_name) >= (int)sizeof(path)
+			|| snprintf(into, sizeof(into), "%s/%s", dst, entry->d_name) >= (int)sizeof(into)){
+			fprintf(stderr, "Error: the path of %s in %s is too long, skipped\n", entry->d_name, src);
+			pool->failed++;
+			continue;
+		}
+		if(lstat(path, &info) != 0){ /* links are not followed, so a loop cannot be walked forever */
+			continue;
+		}
+		
+		if(S_ISDIR(info.st_mode)){
+			if(info.st_dev == pool->dstDevice && info.st_ino == pool->dstInode){ /* dst is inside src, and holds the output */
+				continue;
+			}
+			findSounds(pool, path, into);
+		} else if(S_ISREG(info.st_mode)){
+			int kind = soundKind(path);
+			if(kind == 0){ /* not a sound file */
+				continue;
+			}
+			
+			if(pool->numFiles == pool->capacity){
+				pool->capacity = pool->capacity ? pool->capacity * 2 : 64;
+				pool->files = realloc(pool->files, pool->capacity * sizeof(convfile_t *));
+			}
+			convfile_t *file = calloc(1, sizeof(convfile_t));
+			strcpy(file->in, path);
+			file->size = info.st_size;
+			file->mode = info.st_mode & 07777;
+			file->toCs229b = pool->forceCS229B;
+			file->toCs229 = !pool->forceAIFF && !pool->forceCS229B && (kind == 1 || pool->forceCS229); /* the other format unless one is forced */
+			if(!outputName(file->out, dst, entry->d_name, file->toCs229b ? "cs229b" : (file->toCs229 ? "cs229" : "aiff"))){
+				fprintf(stderr, "Error: the converted path of %s is too long, skipped\n", path);
+				free(file);
+				pool->failed++;
+				continue;
+			}
+			pthread_mutex_init(&file->lock, NULL);
+			pool->files[pool->numFiles++] = file;
+		}
+	}
+	closedir(dir);
+}
+
+/**
+*	Returns 1 if the file starts like an AIFF file, 2 if it starts like a CS229 file, and 0 otherwise
+*/
+int soundKind(char *path){
+	FILE *stream = fopen(path, "r");
+	if(!stream){
+		return 0;
+	}
+	char start[5] = {0};
+	int numBytes = fread(start, 1, 5, stream);
+	fclose(stream);
+	if(numBytes >= 4 && strncmp(start, "FORM", 4) == 0){
+		return 1;
+	} else if(numBytes == 5 && strncmp(start, "CS229", 5) == 0){
+		return 2;
+	}
+	return 0;
+}
+
+/**
+*	Puts the path in dst of the converted name in to, with its .aiff, .aif, .cs229 or .cs229b extension swapped for extension.
+*	Returns 0 if it does not fit in MAX_PATH_LENGTH
+*/
+int outputName(char *to, char *dst, char *name, const char *extension){
+	char base[MAX_PATH_LENGTH];
+	if(strlen(name) >= sizeof(base)){
+		return 0;
+	}
+	strcpy(base, name);
+	char *dot = strrchr(base, '.');
+	if(dot && (strcasecmp(dot, ".aiff") == 0 || strcasecmp(dot, ".aif") == 0 || strcasecmp(dot, ".cs229") == 0 || strcasecmp(dot, ".cs229b") == 0)){
+		*dot = '\0';
+	}
+	return snprintf(to, MAX_PATH_LENGTH, "%s/%s.%s", dst, base, extension) < MAX_PATH_LENGTH;
+}
+
+/**
+*	Leaves out every file whose output would be written over the output of another, as a.aif and a.aiff both make a.cs229,
+*	or over another file being converted, as when dst is src. Each is reported and counted as failed
+*/
+void dropCollisions(convpool_t *pool){
+	int numNames = pool->numFiles * 2;
+	convname_t *names = malloc((numNames ? numNames : 1) * sizeof(convname_t));
+	int i;
+	for(i = 0; i < pool->numFiles; i++){
+		names[2 * i].path = pool->files[i]->in;
+		names[2 * i].file = pool->files[i];
+		names[2 * i].isOutput = 0;
+		names[2 * i + 1].path = pool->files[i]->out;
+		names[2 * i + 1].file = pool->files[i];
+		names[2 * i + 1].isOutput = 1;
+	}
+	qsort(names, numNames, sizeof(convname_t), compareNames);
+	
+	int start;
+	int end;
+	for(start = 0; start < numNames; start = end){ /* each run of the same path */
+		int numOutputs = 0;
+		int shared = 1; /* 1 if the whole run belongs to one file, which may be converted over itself */
+		for(end = start; end < numNames && strcmp(names[end].path, names[start].path) == 0; end++){
+			numOutputs += names[end].isOutput;
+			shared &= (names[end].file == names[start].file);
+		}
+		for(i = start; i < end && numOutputs > 0 && !shared; i++){
+			if(names[i].isOutput){
+				names[i].file->collides = 1;
+			}
+		}
+	}
+	free(names);
+	
+	int kept = 0;
+	for(i = 0; i < pool->numFiles; i++){
+		convfile_t *file = pool->files[i];
+		if(file->collides){
+			fprintf(stderr, "Error: converting %s would write over %s, which another file is converted to or from, skipped\n", file->in, file->out);
+			pthread_mutex_destroy(&file->lock);
+			free(file);
+			pool->failed++;
+		} else {
+			pool->files[kept++] = file;
+		}
+	}
+	pool->numFiles = kept;
+}
+
+/**
+*	Orders names by their paths
+*/
+int compareNames(const void *a, const void *b){
+	return strcmp(((convname_t *)a)->path, ((convname_t *)b)->path);
+}
+
+/**
+*	Orders the files from the biggest to the smallest
+*/
+int compareSizes(const void *a, const void *b){
+	long first = (*(convfile_t **)a)->size;
+	long second = (*(convfile_t **)b)->size;
+	return (first < second) - (first > second);
+}
+
+/**
+*	Adds a task for a file to the newest end of a worker's queue, and wakes an idle worker to take it
+*/
+void pushTask(convpool_t *pool, int index, convfile_t *file, int chunk){
+	taskqueue_t *queue = &pool->queues[index];
+	pthread_mutex_lock(&queue->lock);
+	if(queue->bottom == queue->capacity){
+		if(queue->top > 0){ /* move the tasks down over the ones that were taken */
+			memmove(queue->tasks, queue->tasks + queue->top, (queue->bottom - queue->top) * sizeof(convtask_t));
+			queue->bottom -= queue->top;
+			queue->top = 0;
+		} else {
+			queue->capacity = queue->capacity ? queue->capacity * 2 : 16;
+			queue->tasks = realloc(queue->tasks, queue->capacity * sizeof(convtask_t));
+		}
+	}
+	queue->tasks[queue->bottom].file = file;
+	queue->tasks[queue->bottom].chunk = chunk;
+	queue->bottom++;
+	pthread_mutex_unlock(&queue->lock);
+	
+	pthread_mutex_lock(&pool->idleLock);
+	pool->pending++;
+	pool->pushes++;
+	pthread_cond_signal(&pool->idle);
+	pthread_mutex_unlock(&pool->idleLock);
+}
+
+/**
+*	Takes the newest task of the worker's own queue. Returns 0 if it is empty
+*/
+int popTask(taskqueue_t *queue, convtask_t *task){
+	int found = 0;
+	pthread_mutex_lock(&queue->lock);
+	if(queue->bottom > queue->top){
+		*task = queue->tasks[--queue->bottom];
+		found = 1;
+	}
+	if(queue->bottom == queue->top){
+		queue->top = 0;
+		queue->bottom = 0;
+	}
+	pthread_mutex_unlock(&queue->lock);
+	return found;
+}
+
+/**
+*	Takes the oldest task of another worker's queue. Returns 0 if it is empty
+*/
+int stealTask(taskqueue_t *queue, convtask_t *task){
+	int found = 0;
+	pthread_mutex_lock(&queue->lock);
+	if(queue->bottom > queue->top){
+		*task = queue->tasks[queue->top++];
+		found = 1;
+	}
+	pthread_mutex_unlock(&queue->lock);
+	return found;
+}
+
+/**
+*	Runs tasks from the worker's own queue, or stolen from the others, until every task is finished
+*/
+void *convWorker(void *arg){
+	convworker_t *worker = arg;
+	convpool_t *pool = worker->pool;
+	convtask_t task;
+	for(;;){
+		pthread_mutex_lock(&pool->idleLock);
+		long seen = pool->pushes;
+		pthread_mutex_unlock(&pool->idleLock);
+		
+		int found = popTask(&pool->queues[worker->index], &task);
+		int i;
+		for(i = 1; !found && i < pool->numWorkers; i++){
+			found = stealTask(&pool->queues[(worker->index + i) % pool->numWorkers], &task);
+		}
+		
+		if(found){
+			if(task.chunk < 0){
+				readTask(pool, worker->index, task.file);
+			} else {
+				chunkTask(pool, task.file, task.chunk);
+			}
+			pthread_mutex_lock(&pool->idleLock);
+			if(--pool->pending == 0){ /* a task only pushes more before it finishes, so nothing is left */
+				pthread_cond_broadcast(&pool->idle);
+			}
+			pthread_mutex_unlock(&pool->idleLock);
+		} else {
+			pthread_mutex_lock(&pool->idleLock);
+			while(pool->pending > 0 && pool->pushes == seen){ /* nothing to take until something is pushed */
+				pthread_cond_wait(&pool->idle, &pool->idleLock);
+			}
+			int done = (pool->pending == 0);
+			pthread_mutex_unlock(&pool->idleLock);
+			if(done){
+				return NULL;
+			}
+		}
+	}
+}
+
+/**
+*	Reads and decodes a file, and writes the header of the converted file to a temporary file next to where it goes.
+*	The samples are then encoded here if there is one chunk of them or one worker, otherwise pushed as a task per chunk
+*/
+void readTask(convpool_t *pool, int queue, convfile_t *file){
+	file->handle = sndOpen(NULL);
+	if(!file->handle){
+		failFile(pool, file, "error allocating memory for sample data.");
+		return;
+	}
+	if(sndReadFile(file->handle, file->in) != SND_OK){
+		failFile(pool, file, sndError(file->handle));
+		return;
+	}
+	
+	file->converted = *handleSound(file->handle); /* the sample data is shared, only the format differs */
+	strcpy(file->converted.format, file->toCs229b ? "CS229B" : (file->toCs229 ? "CS229" : "AIFF"));
+	file->converted.coding = pool->coding;
+	snprintf(file->temp, sizeof(file->temp), "%s.XXXXXX", file->out);
+	int fd = mkstemp(file->temp);
+	if(fd == -1 || !(file->to = fdopen(fd, "w"))){
+		if(fd != -1){
+			close(fd);
+			unlink(file->temp);
+		}
+		file->temp[0] = '\0';
+		failFile(pool, file, "could not open file for writing");
+		return;
+	}
+	fchmod(fd, file->mode); /* mkstemp makes it readable only by its owner */
+	if(file->toCs229b){
+		writeCs229bHeader(&file->converted, file->to);
+	} else if(file->toCs229){
+		writeCs229Header(&file->converted, file->to);
+	} else {
+		writeAiffHeader(&file->converted, file->to);
+	}
+	
+	file->numChunks = (file->converted.samples + CHUNK_FRAMES - 1) / CHUNK_FRAMES;
+	int delta = file->toCs229b && pool->coding == SND_CODING_DELTA; /* each frame depends on the one before, so it is written in one go */
+	if(file->numChunks <= 1 || pool->numWorkers == 1 || delta){ /* no other worker could take the chunks */
+		if(delta){
+			int *previous = calloc(file->converted.channels, sizeof(int));
+			if(!previous){
+				failFile(pool, file, "error allocating memory for sample data.");
+				return;
+			}
+			writeCs229bFrames(&file->converted, file->converted.sampleData, file->converted.samples, previous, file->to);
+			free(previous);
+		} else if(file->converted.samples > 0){
+			writeFrames(&file->converted, file->converted.sampleData, file->converted.samples, file->to);
+		}
+		finishFile(pool, file);
+		return;
+	}
+	
+	file->chunks = calloc(file->numChunks, sizeof(char *));
+	file->chunkSizes = calloc(file->numChunks, sizeof(size_t));
+	if(!file->chunks || !file->chunkSizes){
+		failFile(pool, file, "error allocating memory for sample data.");
+		return;
+	}
+	int chunk;
+	for(chunk = file->numChunks - 1; chunk >= 0; chunk--){ /* the first chunk is pushed last, so this worker takes it next */
+		pushTask(pool, queue, file, chunk);
+	}
+}
+
+/**
+*	Encodes a chunk of a file's frames into memory, then hands it to commitChunk to be written in order
+*/
+void chunkTask(convpool_t *pool, convfile_t *file, int chunk){
+	soundfile_t *snd = &file->converted;
+	int start = chunk * CHUNK_FRAMES;
+	int numFrames = (snd->samples - start < CHUNK_FRAMES) ? snd->samples - start : CHUNK_FRAMES;
+	long frameBytes = (long)snd->channels * sampleWidth(snd->bitDepth);
+	
+	long most = (long)numFrames * frameBytes; /* AIFF and raw CS229B are at most as big as they are kept */
+	if(file->toCs229){
+		most = (long)numFrames * (snd->channels * 12 + 1); /* "-2147483648\t" per value, and "\n" */
+	} else if(file->toCs229b){
+		most = (long)numFrames * snd->channels * 5; /* a varint of a 32 bit value takes up to 5 bytes */
+	}
+	char *data = malloc(most + 1);
+	FILE *encoded = data ? fmemopen(data, most + 1, "w") : NULL;
+	if(!encoded){
+		fprintf(stderr, "Error: error allocating memory for sample data.\n");
+		exit(EXIT_FAILURE);
+	}
+	setvbuf(encoded, NULL, _IONBF, 0); /* the writers fill their own buffer, it goes straight into data */
+	writeFrames(snd, (char *)snd->sampleData + start * frameBytes, numFrames, encoded);
+	size_t size = ftell(encoded);
+	fclose(encoded);
+	commitChunk(pool, file, chunk, data, size);
+}
+
+/**
+*	Keeps an encoded chunk until the chunks before it are written, then writes it and any after it that are waiting.
+*	The worker that writes the last chunk finishes the file
+*/
+void commitChunk(convpool_t *pool, convfile_t *file, int chunk, char *data, size_t size){
+	pthread_mutex_lock(&file->lock);
+	file->chunks[chunk] = data;
+	file->chunkSizes[chunk] = size;
+	while(file->nextChunk < file->numChunks && file->chunks[file->nextChunk]){
+		fwrite(file->chunks[file->nextChunk], 1, file->chunkSizes[file->nextChunk], file->to);
+		free(file->chunks[file->nextChunk]);
+		file->chunks[file->nextChunk] = NULL;
+		file->nextChunk++;
+	}
+	int done = (file->nextChunk == file->numChunks);
+	pthread_mutex_unlock(&file->lock);
+	
+	if(done){
+		finishFile(pool, file);
+	}
+}
+
+/**
+*	Closes the converted file and renames it to where it goes, then frees the sound and counts the file
+*/
+void finishFile(convpool_t *pool, convfile_t *file){
+	long written = ftell(file->to);
+	int failed = (fflush(file->to) != 0 || ferror(file->to));
+	failed |= (fclose(file->to) != 0);
+	file->to = NULL;
+	if(failed || rename(file->temp, file->out) != 0){
+		failFile(pool, file, "could not write the converted file");
+		return;
+	}
+	
+	long frames = file->converted.samples;
+	sndClose(file->handle);
+	file->handle = NULL;
+	free(file->chunks);
+	free(file->chunkSizes);
+	file->chunks = NULL;
+	file->chunkSizes = NULL;
+	
+	pthread_mutex_lock(&pool->idleLock);
+	pool->converted++;
+	pool->readBytes += file->size;
+	pool->writtenBytes += written;
+	pool->frames += frames;
+	pthread_mutex_unlock(&pool->idleLock);
+}
+
+/**
+*	Reports that a file could not be converted and frees what it had, the other files go on
+*/
+void failFile(convpool_t *pool, convfile_t *file, const char *message){
+	fprintf(stderr, "Error: %s: %s\n", file->in, message);
+	if(file->to){
+		fclose(file->to);
+		file->to = NULL;
+	}
+	if(file->temp[0]){
+		unlink(file->temp);
+	}
+	sndClose(file->handle);
+	file->handle = NULL;
+	free(file->chunks);
+	free(file->chunkSizes);
+	file->chunks = NULL;
+	file->chunkSizes = NULL;
+	
+	pthread_mutex_lock(&pool->idleLock);
+	pool->failed++;
+	pthread_mutex_unlock(&pool->idleLock);
+}
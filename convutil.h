@@ -0,0 +1,96 @@
+/* Author: Seth George */
+
+#ifndef CONVUTIL_H
+#define CONVUTIL_H
+
+#include "sndutil.h"
+#include <pthread.h>
+#include <sys/types.h>
+
+#define CHUNK_FRAMES (BLOCK_FRAMES * 64) /* frames a task of a big file encodes, so its chunks can go to other workers */
+#define MAX_PATH_LENGTH 4096
+
+typedef struct {
+	char in[MAX_PATH_LENGTH]; /* file to convert */
+	char out[MAX_PATH_LENGTH]; /* where the converted file goes */
+	char temp[MAX_PATH_LENGTH + 8]; /* the file being written, renamed to out once it is complete */
+	long size; /* bytes of the input */
+	int mode; /* permissions of the input, which the converted file gets too */
+	int toCs229; /* 1 to write CS229, 0 for AIFF */
+	int toCs229b; /* 1 to write CS229B, toCs229 is then 0 */
+	int collides; /* 1 if out is the input or output of another file too */
+	sndhandle_t *handle; /* the sound once it has been read */
+	soundfile_t converted; /* its header with the format it is written in, sharing its sample data */
+	FILE *to;
+	int numChunks;
+	int nextChunk; /* the chunk to be written next, the ones after it wait in chunks */
+	char **chunks; /* encoded chunks that are done but not written yet */
+	size_t *chunkSizes;
+	pthread_mutex_t lock;
+} convfile_t;
+
+typedef struct {
+	char *path;
+	convfile_t *file; /* the file the path is the input or output of */
+	int isOutput;
+} convname_t;
+
+typedef struct {
+	convfile_t *file;
+	int chunk; /* chunk of the file to encode, -1 to read the file and start its chunks */
+} convtask_t;
+
+typedef struct {
+	convtask_t *tasks;
+	int top; /* oldest task, the one other workers steal */
+	int bottom; /* one past the newest, where the owner pushes and pops */
+	int capacity;
+	pthread_mutex_t lock;
+} taskqueue_t;
+
+typedef struct {
+	convfile_t **files;
+	int numFiles;
+	int capacity;
+	int forceAIFF;
+	int forceCS229;
+	int forceCS229B;
+	int coding; /* of the CS229B files written */
+	dev_t dstDevice; /* dst, which is not walked if it is inside src */
+	ino_t dstInode;
+	taskqueue_t *queues; /* one per worker */
+	int numWorkers;
+	long pending; /* tasks pushed and not yet finished, the workers stop when it reaches 0 */
+	long pushes; /* counts pushes, so an idle worker knows when to look again */
+	pthread_mutex_t idleLock;
+	pthread_cond_t idle; /* signalled on a push, and when pending reaches 0 */
+	int converted; /* totals for the report at the end */
+	int failed;
+	long readBytes;
+	long writtenBytes;
+	long frames;
+} convpool_t;
+
+typedef struct {
+	convpool_t *pool;
+	int index; /* of its queue */
+} convworker_t;
+
+int convertTree(char *src, char *dst, int forceAIFF, int forceCS229, int forceCS229B, int coding, int numThreads);
+void findSounds(convpool_t *pool, char *src, char *dst);
+int soundKind(char *path);
+int outputName(char *to, char *dst, char *name, const char *extension);
+void dropCollisions(convpool_t *pool);
+int compareNames(const void *a, const void *b);
+int compareSizes(const void *a, const void *b);
+void pushTask(convpool_t *pool, int queue, convfile_t *file, int chunk);
+int popTask(taskqueue_t *queue, convtask_t *task);
+int stealTask(taskqueue_t *queue, convtask_t *task);
+void *convWorker(void *arg);
+void readTask(convpool_t *pool, int queue, convfile_t *file);
+void chunkTask(convpool_t *pool, convfile_t *file, int chunk);
+void commitChunk(convpool_t *pool, convfile_t *file, int chunk, char *data, size_t size);
+void finishFile(convpool_t *pool, convfile_t *file);
+void failFile(convpool_t *pool, convfile_t *file, const char *message);
+
+#endif
@@ -0,0 +1,903 @@
+/* Author: Seth George */
+
+#include "cs229util.h"
+#include "aiffutil.h"
+#include <ctype.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+*	Parses CS229 files 
+*/
+void parseCs229(soundfile_t *snd){
+	parseHeader(snd);
+	parseData(snd);
+}
+
+/**
+*	Reads only the header of CS229 files, stopping at StartData when Samples is given.
+*	Otherwise the samples are counted but not stored
+*/
+void probeCs229(soundfile_t *snd){
+	parseHeader(snd);
+	if(snd->samples <= 0){ /* parseData treats a missing or zero Samples as unspecified */
+		countData(snd);
+	}
+}
+
+/**
+*	Parses the header of CS229 files, checking for keywords and their corresponding values.
+*	Stops once StartData is found.
+*/
+void parseHeader(soundfile_t *snd){
+	char keyword[16]; /* token held for comparison */
+	while(strcmp(keyword, "StartData") != 0){
+		fscanf(snd->stream, "%s", keyword);
+		if(feof(snd->stream)){ /* check if end of file */
+			sndFail(SND_ERR_FORMAT, "found end of file before StartData\n");
+		}
+		if(strcmp(keyword, "SampleRate") == 0){	
+			if(snd->sampleRate){
+				sndFail(SND_ERR_FORMAT, "duplicate keyword SampleRate\n");
+			}
+			
+			snd->sampleRate = parseKeywordValue(snd->stream, 0);
+			parseNewLine(0, snd->stream);
+		} else if(strcmp(keyword, "BitDepth") == 0){			
+			if(snd->bitDepth){
+				sndFail(SND_ERR_FORMAT, "duplicate keyword BitDepth\n");
+			}
+			snd->bitDepth = parseKeywordValue(snd->stream, 0);
+			parseNewLine(0, snd->stream);	
+		} else if(strcmp(keyword, "Channels") == 0){			
+			if(snd->channels){
+				sndFail(SND_ERR_FORMAT, "duplicate keyword Channels\n");
+			}
+			snd->channels = parseKeywordValue(snd->stream, 0);
+			parseNewLine(0, snd->stream);
+		} else if(strcmp(keyword, "Samples") == 0){			
+			if(snd->samples != -1){
+				sndFail(SND_ERR_FORMAT, "duplicate keyword Samples\n");
+			}
+			snd->samples = parseKeywordValue(snd->stream, 1);
+			parseNewLine(0, snd->stream);
+		} else if(strcmp(keyword, "Coding") == 0 && strcmp(snd->format, "CS229B") == 0){
+			snd->coding = parseCoding(snd->stream);
+			parseNewLine(0, snd->stream);
+		} else if(strcmp(keyword, "Endian") == 0 && strcmp(snd->format, "CS229B") == 0){
+			snd->byteSwapped = parseEndian(snd->stream);
+			parseNewLine(0, snd->stream);
+		} else if(strcmp(keyword, "#") == 0){
+			parseNewLine(1, snd->stream); /* skip everything after # */
+		} else if(strcmp(keyword, "StartData") == 0){ /* will leave the loop next iteration */
+			keywordsAreSet(snd); /* check if necessary keywords are set to not 0 */
+		} else {
+			sndFail(SND_ERR_FORMAT, "invalid keyword found: %s\n", keyword);
+		}
+	}
+}
+
+/**
+*	Parses for a positive int value
+*/
+int parseKeywordValue(FILE *stream, int isSamples){
+	int value = 0;
+	int isNum = 0;
+	
+	isNum = fscanf(stream, "%d", &value);
+	if(isNum != 0){ /* check that fscanf returned true */
+		if(isNum == EOF){ /* check fscanf did not return end of file */
+			sndFail(SND_ERR_FORMAT, "found end of file before StartData\n");
+		}
+		
+		if(value <= 0 && !isSamples){ /*if keyword is negative or not Samples */
+			sndFail(SND_ERR_FORMAT, "keyword value must be non-zero positive");
+		} else if(value < 0){ /*Samples can be zero */
+			sndFail(SND_ERR_FORMAT, "keyword value must be positive");
+		}
+	}
+	return value;
+}
+
+/**
+*	Finds the end of a line
+*/
+void parseNewLine(int isComment, FILE *stream){
+	char c = 0;
+	while(c != '\n'){
+		c = fgetc(stream);
+		if(c == EOF){ /* check if is end of file */
+			sndFail(SND_ERR_FORMAT, "found end of file before StartData\n");
+		}
+		if(!isComment){
+			if(!isspace(c)){ /* check if is not white space*/
+				sndFail(SND_ERR_FORMAT, "unexpected character after value");
+			}
+		}
+	}
+}
+
+/**
+*	Sets up a tokenizer that reads the stream a block at a time
+*/
+void initTokenizer(tokenizer_t *tok, FILE *stream){
+	tok->stream = stream;
+	tok->buffer = malloc(READ_BLOCK);
+	tok->pos = 0;
+	tok->length = 0;
+	tok->bytesRead = 0;
+	tok->start = ftell(stream); /* -1 if the stream cannot seek */
+}
+
+/**
+*	Frees the tokenizer's block
+*/
+void freeTokenizer(tokenizer_t *tok){
+	free(tok->buffer);
+	tok->buffer = NULL;
+}
+
+/**
+*	Reads the next block of the stream, returns 0 at end of file
+*/
+int fillTokenizer(tokenizer_t *tok){
+	tok->length = fread(tok->buffer, 1, READ_BLOCK, tok->stream);
+	tok->pos = 0;
+	tok->bytesRead += tok->length;
+	return tok->length > 0;
+}
+
+/**
+*	Parses the next signed decimal integer, like fscanf("%lld") without the locale and format handling.
+*	The value is not clamped, so one too big for the bit depth is still out of its range.
+*	Returns 1 if an int was found, 0 if the next token is not a number, or EOF at end of file
+*/
+int nextInt(tokenizer_t *tok, long long *value){
+	char c;
+	for(;;){ /* skip white space */
+		if(tok->pos == tok->length && !fillTokenizer(tok)){
+			return EOF;
+		}
+		c = tok->buffer[tok->pos];
+		if(c != ' ' && c != '\t' && c != '\n' && c != '\r' && c != '\v' && c != '\f'){
+			break;
+		}
+		tok->pos++;
+	}
+	
+	int isNeg = 0;
+	if(c == '-' || c == '+'){
+		isNeg = (c == '-');
+		tok->pos++;
+	}
+	
+	long long num = 0;
+	int digits = 0;
+	for(;;){
+		while(tok->pos < tok->length){ /* the common case, digits within the block */
+			c = tok->buffer[tok->pos];
+			if(c < '0' || c > '9'){
+				break;
+			}
+			if(num < INT64_MAX/10){ /* stop growing before it overflows, it is far out of range and rejected later */
+				num = num*10 + (c - '0');
+			}
+			digits++;
+			tok->pos++;
+		}
+		if(tok->pos < tok->length || !fillTokenizer(tok)){ /* the number ended, or continues in the next block */
+			break;
+		}
+	}
+	
+	if(!digits){
+		return 0;
+	}
+	if(isNeg){
+		num = -num;
+	}
+	*value = num;
+	return 1;
+}
+
+/**
+*	Returns the stream position of the next unread byte
+*/
+long tokenOffset(tokenizer_t *tok){
+	return tok->start + tok->bytesRead - tok->length + tok->pos;
+}
+
+/**
+*	Parses through all the samples, checking for errors
+*/
+void parseData(soundfile_t *snd){
+	long long value; /* holds sample value */
+	int found = 0;
+	int dataPoints = 0;
+	int width = sampleWidth(snd->bitDepth);
+	long long upper = (1LL << (snd->bitDepth - 1)) - 1; /* bit depth limits, checked inline */
+	long long lower = -(1LL << (snd->bitDepth - 1));
+	int num;
+	tokenizer_t tok;
+	initTokenizer(&tok, snd->stream);
+	
+	if(snd->samples > 0){ /* if samples are specified and not zero */
+		dataPoints = snd->samples * snd->channels;
+	} else {
+		dataPoints = BLOCK_FRAMES * snd->channels; /* grows as samples are found */
+	}
+	snd->sampleData = malloc(dataPoints * width);
+	if(snd->sampleData == NULL) {
+		sndFail(SND_ERR_MEMORY, "error allocating memory for sample data.\n");
+	}
+	
+	while((num = nextInt(&tok, &value)) != EOF){ /*while it is not end of file */
+		if(num < 1){ /* check if an int could be found */
+			sndFail(SND_ERR_DATA, "invalid value found %c\n", num);
+		}
+		
+		if(found >= dataPoints){
+			if(snd->samples > 0){ /* if there are too many */
+				sndFail(SND_ERR_DATA, "specified number of samples, %d, was more than read number of samples, %d\n", found, dataPoints);
+			}
+			dataPoints *= 2;
+			snd->sampleData = realloc(snd->sampleData, (dataPoints * width));
+			if(snd->sampleData == NULL) {
+				sndFail(SND_ERR_MEMORY, "error allocating memory for sample data.\n");
+			}
+		}
+		
+		if(value < lower || value > upper){
+			checkBitDepth(value, snd->bitDepth); /* reports the error */
+		}
+		writeSample(snd->sampleData, width, found, value);
+		found++; /* found used as index */
+	}
+	freeTokenizer(&tok);
+	
+	if(snd->samples > 0){
+		if(found < dataPoints){ /* if there are not enough */
+			sndFail(SND_ERR_DATA, "specified number of samples, %d, was fewer than read number of samples, %d\n", found, dataPoints);
+		}
+	} else {
+		if(found % snd->channels){
+			sndFail(SND_ERR_DATA, "found end of file before reading all channels\n");
+		}
+		snd->samples = found/snd->channels;
+		snd->sampleData = realloc(snd->sampleData, (found * width) + 1); /* cut off the extra off the end */
+	}
+}
+
+/**
+*	Counts the samples after StartData without storing them, checking for errors
+*/
+void countData(soundfile_t *snd){
+	long long value; /* holds sample value */
+	int found = 0;
+	int num;
+	long long upper = (1LL << (snd->bitDepth - 1)) - 1;
+	long long lower = -(1LL << (snd->bitDepth - 1));
+	tokenizer_t tok;
+	initTokenizer(&tok, snd->stream);
+	
+	while((num = nextInt(&tok, &value)) != EOF){ /*while it is not end of file */
+		if(num < 1){ /* check if an int could be found */
+			sndFail(SND_ERR_DATA, "invalid value found %c\n", num);
+		}
+		if(value < lower || value > upper){
+			checkBitDepth(value, snd->bitDepth); /* reports the error */
+		}
+		found++;
+	}
+	freeTokenizer(&tok);
+	
+	if(found % snd->channels){
+		sndFail(SND_ERR_DATA, "found end of file before reading all channels\n");
+	}
+	snd->samples = found/snd->channels;
+}
+
+/**
+*	Writes the CS229 file with the [low..high] ranges removed, parsing its samples a block at a time.
+*	The header must have been read by parseHeader and give the number of samples. The ranges must be merged by mergeRanges
+*/
+void cutCs229Stream(int low[], int high[], int numRestrictions, soundfile_t *snd, FILE *to){
+	int frameBytes = snd->channels * sampleWidth(snd->bitDepth);
+	long long value;
+	
+	soundfile_t out = *snd;
+	out.samples = keptFrames(low, high, numRestrictions, snd->samples);
+	writeCs229Header(&out, to);
+	
+	char *block = malloc((long)BLOCK_FRAMES * frameBytes);
+	tokenizer_t tok;
+	initTokenizer(&tok, snd->stream);
+	int range = 0;
+	int frame;
+	for(frame = 0; frame < snd->samples; frame += BLOCK_FRAMES){
+		int end = frame + BLOCK_FRAMES;
+		if(end > snd->samples){
+			end = snd->samples;
+		}
+		
+		int found = readCs229Frames(&tok, snd, block, end - frame);
+		if(found < end - frame){ /* if there are not enough */
+			sndFail(SND_ERR_DATA, "specified number of samples, %d, was more than read number of samples, %d\n", snd->samples, frame + found);
+		}
+		
+		int start, spanEnd;
+		for(start = keptSpan(frame, end, low, high, numRestrictions, &range, &spanEnd); start < end;
+				start = keptSpan(spanEnd, end, low, high, numRestrictions, &range, &spanEnd)){
+			writeCs229Frames(snd, block + (long)(start - frame) * frameBytes, spanEnd - start, to);
+		}
+	}
+	
+	if(nextInt(&tok, &value) != EOF){ /* if there are too many */
+		sndFail(SND_ERR_DATA, "specified number of samples, %d, was fewer than read number of samples\n", snd->samples * snd->channels);
+	}
+	freeTokenizer(&tok);
+	free(block);
+}
+
+/**
+*	Parses up to numFrames frames of samples from tok into data, stored at the width given by sampleWidth.
+*	Returns the number of frames read, which is fewer only at the end of the stream
+*/
+int readCs229Frames(tokenizer_t *tok, soundfile_t *snd, void *data, int numFrames){
+	int width = sampleWidth(snd->bitDepth);
+	long long upper = (1LL << (snd->bitDepth - 1)) - 1; /* bit depth limits, checked inline */
+	long long lower = -(1LL << (snd->bitDepth - 1));
+	long long value;
+	int num;
+	int i;
+	for(i = 0; i < numFrames * snd->channels; i++){
+		num = nextInt(tok, &value);
+		if(num == EOF){
+			break;
+		} else if(num < 1){ /* check if an int could be found */
+			sndFail(SND_ERR_DATA, "invalid value found %c\n", num);
+		}
+		if(value < lower || value > upper){
+			checkBitDepth(value, snd->bitDepth); /* reports the error */
+		}
+		writeSample(data, width, i, value);
+	}
+	
+	if(i % snd->channels){
+		sndFail(SND_ERR_DATA, "found end of file before reading all channels\n");
+	}
+	return i / snd->channels;
+}
+
+/**
+*	Reads numFrames frames of samples into data, like readCs229Frames but without ending the program.
+*	Returns what was wrong with them, or NULL if nothing was
+*/
+const char *parseBlock(tokenizer_t *tok, soundfile_t *snd, void *data, int numFrames){
+	int width = sampleWidth(snd->bitDepth);
+	long long upper = (1LL << (snd->bitDepth - 1)) - 1; /* bit depth limits */
+	long long lower = -(1LL << (snd->bitDepth - 1));
+	long long value;
+	int num;
+	int i;
+	for(i = 0; i < numFrames * snd->channels; i++){
+		num = nextInt(tok, &value);
+		if(num == EOF){
+			return "specified number of samples was more than read number of samples";
+		} else if(num < 1){ /* check if an int could be found */
+			return "invalid value found";
+		} else if(value < lower || value > upper){
+			return "found sample beyond excepted bit depth limits";
+		}
+		writeSample(data, width, i, value);
+	}
+	return NULL;
+}
+
+/**
+*	Gets snd, whose header was just parsed, ready to have its blocks read in any order with fillCs229Block.
+*	That needs the number of samples and a stream that can seek, returns 0 if it does not have them
+*/
+int indexCs229(soundfile_t *snd){
+	long start = ftell(snd->stream);
+	if(snd->samples <= 0 || start == -1){
+		return 0;
+	}
+	int numBlocks = (snd->samples + BLOCK_FRAMES - 1) / BLOCK_FRAMES;
+	snd->offsets = malloc(numBlocks * sizeof(long));
+	snd->offsets[0] = start;
+	snd->numOffsets = 1;
+	return 1;
+}
+
+/**
+*	Parses a block of an indexed CS229 file into data. The blocks past the last one found so far are
+*	read through first, keeping where each starts. Returns what was wrong with the samples, or NULL
+*/
+const char *fillCs229Block(soundfile_t *snd, int block, void *data){
+	int numBlocks = (snd->samples + BLOCK_FRAMES - 1) / BLOCK_FRAMES;
+	int from = (block < snd->numOffsets) ? block : snd->numOffsets - 1;
+	const char *error = NULL;
+	tokenizer_t *tok = snd->reader;
+	if(tok && snd->readerBlock < block && snd->readerBlock + 1 >= from){ /* go on from the last block parsed, blocks are mostly asked for in order */
+		from = snd->readerBlock + 1;
+	} else {
+		if(!tok){
+			tok = malloc(sizeof(tokenizer_t));
+			snd->reader = tok;
+		} else {
+			freeTokenizer(tok);
+		}
+		fseek(snd->stream, snd->offsets[from], SEEK_SET);
+		initTokenizer(tok, snd->stream);
+	}
+	
+	int i;
+	for(i = from; i <= block && !error; i++){
+		int frame = i * BLOCK_FRAMES;
+		int numFrames = (snd->samples - frame < BLOCK_FRAMES) ? snd->samples - frame : BLOCK_FRAMES;
+		error = parseBlock(tok, snd, data, numFrames); /* the blocks before the one asked for are parsed over each other */
+		if(!error && i + 1 == snd->numOffsets && i + 1 < numBlocks){
+			snd->offsets[snd->numOffsets++] = tokenOffset(tok);
+		}
+	}
+	snd->readerBlock = error ? -1 : block; /* after an error the reader is not at a block */
+	
+	long long value;
+	if(!error && block == numBlocks - 1 && nextInt(tok, &value) != EOF){
+		error = "specified number of samples was fewer than read number of samples";
+	}
+	return error;
+}
+
+/**
+*	Frees the block positions and the reader of an indexed CS229 file
+*/
+void freeCs229Index(soundfile_t *snd){
+	if(snd->reader){
+		freeTokenizer(snd->reader);
+		free(snd->reader);
+		snd->reader = NULL;
+	}
+	free(snd->offsets);
+	snd->offsets = NULL;
+	snd->numOffsets = 0;
+}
+
+/**
+*	Write an CS229 file from a AIFF file
+*/
+void writeCs229(soundfile_t *from, FILE* to){
+	writeCs229Header(from, to);
+	
+	int block;
+	int numBlocks = (from->samples + BLOCK_FRAMES - 1) / BLOCK_FRAMES;
+	for(block = 0; block < numBlocks; block++){ /* print all the samples */
+		int numFrames = from->samples - block*BLOCK_FRAMES;
+		if(numFrames > BLOCK_FRAMES){
+			numFrames = BLOCK_FRAMES;
+		}
+		writeCs229Frames(from, frameBlock(from, block), numFrames, to);
+	}
+}
+
+/**
+*	Write everything of an CS229 file up to the sample data, sized for from->samples
+*/
+void writeCs229Header(soundfile_t *from, FILE* to){
+	fprintf(to, "CS229\n"); /* print the gathered values from the parsed file */
+	fprintf(to, "\nSampleRate %d\n", from->sampleRate);
+	fprintf(to, "Samples %d\n", from->samples);
+	fprintf(to, "BitDepth %d\n", from->bitDepth);
+	fprintf(to, "Channels %d\n", from->channels);
+	fprintf(to, "\nStartData\n");
+}
+
+/**
+*	Write numFrames frames of CS229 sample data, one line per frame with a tab after every value.
+*	The lines are formatted into a WRITE_BLOCK buffer that is written in one go when full
+*/
+void writeCs229Frames(soundfile_t *from, const void *data, int numFrames, FILE *to){
+	int width = sampleWidth(from->bitDepth);
+	int lineMax = from->channels * 12 + 1; /* longest possible line, "-2147483648\t" per channel */
+	char *buffer = malloc(WRITE_BLOCK + lineMax);
+	char *end = buffer;
+	int i;
+	int j;
+	int index = 0;
+	
+	if(width == 1){ /* 8 bit files have few enough values to look every one up */
+		char table[256][8]; /* "-128\t" is the longest */
+		char length[256];
+		for(i = 0; i < 256; i++){
+			char *last = formatInt(table[i], i - 128);
+			*last++ = '\t';
+			length[i] = last - table[i];
+		}
+		
+		const int8_t *samples = data;
+		for(i = 0; i < numFrames; i++){
+			for(j = 0; j < from->channels; j++){
+				int entry = samples[index++] + 128;
+				memcpy(end, table[entry], 8); /* copying a fixed 8 is faster, the buffer has room past the end */
+				end += length[entry];
+			}
+			*end++ = '\n';
+			if(end - buffer >= WRITE_BLOCK){
+				fwrite(buffer, 1, end - buffer, to);
+				end = buffer;
+			}
+		}
+	} else {
+		for(i = 0; i < numFrames; i++){
+			for(j = 0; j < from->channels; j++){
+				end = formatInt(end, readSample(data, width, index++));
+				*end++ = '\t';
+			}
+			*end++ = '\n';
+			if(end - buffer >= WRITE_BLOCK){
+				fwrite(buffer, 1, end - buffer, to);
+				end = buffer;
+			}
+		}
+	}
+	
+	fwrite(buffer, 1, end - buffer, to);
+	free(buffer);
+}
+
+/*==================== CS229B ====================*/
+/**
+*	Parses CS229B files, the binary sibling of CS229. The header is the same, with Samples required and
+*	Coding and Endian added, and is padded so the samples after StartData start at a multiple of CS229B_ALIGN.
+*	Raw samples of a regular file are mapped and used in place, otherwise they are read or decoded into memory
+*/
+void parseCs229b(soundfile_t *snd){
+	probeCs229b(snd);
+	if(snd->coding != SND_CODING_RAW){
+		readCodedCs229b(snd);
+	} else if(!mapCs229b(snd)){
+		readRawCs229b(snd);
+	}
+}
+
+/**
+*	Reads only the header of CS229B files, leaving the stream at the first sample.
+*	The size of the samples is checked against what numBytes holds and, for a regular file, against what is left of it,
+*	before anything is allocated or mapped for them
+*/
+void probeCs229b(soundfile_t *snd){
+	parseHeader(snd);
+	if(snd->samples < 0){ /* the samples are not delimited, so they cannot be counted */
+		sndFail(SND_ERR_FORMAT, "Samples is required in CS229B files\n");
+	}
+	if(snd->bitDepth > 32){
+		sndFail(SND_ERR_FORMAT, "BitDepth must be at most 32 in CS229B files\n");
+	}
+	if(fgetc(snd->stream) != '\n'){
+		sndFail(SND_ERR_FORMAT, "expected a new line after StartData\n");
+	}
+	snd->dataStart = ftell(snd->stream); /* -1 if the stream cannot seek */
+	
+	long long count = (long long)snd->samples * snd->channels;
+	long long numBytes = count * sampleWidth(snd->bitDepth);
+	if(numBytes > INT32_MAX){
+		sndFail(SND_ERR_FORMAT, "specified number of samples, %d, is too large\n", snd->samples);
+	}
+	snd->numBytes = numBytes;
+	
+	struct stat info;
+	if(snd->dataStart >= 0 && fstat(fileno(snd->stream), &info) == 0 && S_ISREG(info.st_mode)){
+		long long least = (snd->coding == SND_CODING_RAW) ? numBytes : count; /* a coded value takes at least a byte */
+		if(info.st_size - snd->dataStart < least){
+			sndFail(SND_ERR_DATA, "found end of file before was specified\n");
+		}
+	}
+}
+
+/**
+*	Parses the value of Coding: raw, varint or delta
+*/
+int parseCoding(FILE *stream){
+	char value[16];
+	if(fscanf(stream, "%15s", value) != 1){
+		sndFail(SND_ERR_FORMAT, "found end of file before StartData\n");
+	}
+	if(strcmp(value, "raw") == 0){
+		return SND_CODING_RAW;
+	} else if(strcmp(value, "varint") == 0){
+		return SND_CODING_VARINT;
+	} else if(strcmp(value, "delta") == 0){
+		return SND_CODING_DELTA;
+	}
+	sndFail(SND_ERR_FORMAT, "invalid Coding found: %s\n", value);
+	return SND_CODING_RAW;
+}
+
+/**
+*	Parses the value of Endian, little or big. Returns 1 if it is not the byte order of this machine
+*/
+int parseEndian(FILE *stream){
+	char value[16];
+	if(fscanf(stream, "%15s", value) != 1){
+		sndFail(SND_ERR_FORMAT, "found end of file before StartData\n");
+	}
+	const uint16_t one = 1;
+	int little = (*(const uint8_t *)&one == 1);
+	if(strcmp(value, "little") == 0){
+		return !little;
+	} else if(strcmp(value, "big") == 0){
+		return little;
+	}
+	sndFail(SND_ERR_FORMAT, "invalid Endian found: %s\n", value);
+	return 0;
+}
+
+/**
+*	Maps a CS229B file whose raw samples are in this machine's byte order, and points sampleData at them,
+*	so they are used without being read or copied. The mapping is private, so the samples can still be changed.
+*	Returns 0 without reading anything if the stream is not a regular file or the samples cannot be used in place
+*/
+int mapCs229b(soundfile_t *snd){
+	struct stat info;
+	int width = sampleWidth(snd->bitDepth);
+	if(snd->byteSwapped || snd->numBytes == 0 || snd->dataStart < 0 || snd->dataStart % width != 0
+		|| fstat(fileno(snd->stream), &info) != 0 || !S_ISREG(info.st_mode)){
+		return 0;
+	}
+	checkCs229bEnd(snd, info.st_size - snd->dataStart - snd->numBytes);
+	
+	snd->mappedSize = info.st_size;
+	snd->mapped = mmap(NULL, snd->mappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(snd->stream), 0);
+	if(snd->mapped == MAP_FAILED){
+		snd->mapped = NULL;
+		sndFail(SND_ERR_IO, "could not memory map the file\n");
+	}
+	madvise(snd->mapped, snd->mappedSize, MADV_SEQUENTIAL);
+	snd->sampleData = snd->mapped + snd->dataStart;
+	statsMapped(snd->numBytes); /* its samples are read without read calls */
+	checkRawCs229b(snd);
+	return 1;
+}
+
+/**
+*	Reads the raw samples of a CS229B file into memory, swapping their bytes if they were written in the other order
+*/
+void readRawCs229b(soundfile_t *snd){
+	int width = sampleWidth(snd->bitDepth);
+	long count = (long)snd->samples * snd->channels;
+	snd->sampleData = malloc(snd->numBytes + 1);
+	if(!snd->sampleData){
+		sndFail(SND_ERR_MEMORY, "error allocating memory for sample data.\n");
+	}
+	if(fread(snd->sampleData, 1, snd->numBytes, snd->stream) != snd->numBytes){
+		sndFail(SND_ERR_DATA, "found end of file before was specified\n");
+	}
+	checkCs229bEnd(snd, fgetc(snd->stream) != EOF);
+	
+	long i;
+	if(snd->byteSwapped && width == 2){
+		uint16_t *samples = snd->sampleData;
+		for(i = 0; i < count; i++){
+			samples[i] = __builtin_bswap16(samples[i]);
+		}
+	} else if(snd->byteSwapped && width == 4){
+		uint32_t *samples = snd->sampleData;
+		for(i = 0; i < count; i++){
+			samples[i] = __builtin_bswap32(samples[i]);
+		}
+	}
+	checkRawCs229b(snd);
+}
+
+/**
+*	Decodes the varint or delta coded samples of a CS229B file. Each value is zigzag coded, so small
+*	negative values stay short, then written 7 bits a byte with the high bit set on all but the last.
+*	Delta coded values are the difference from the value of the same channel in the frame before
+*/
+void readCodedCs229b(soundfile_t *snd){
+	int width = sampleWidth(snd->bitDepth);
+	long count = (long)snd->samples * snd->channels;
+	long long upper = (1LL << (snd->bitDepth - 1)) - 1;
+	long long lower = -(1LL << (snd->bitDepth - 1));
+	int delta = (snd->coding == SND_CODING_DELTA);
+	snd->sampleData = malloc(snd->numBytes + 1);
+	unsigned char *buffer = malloc(READ_BLOCK);
+	long long *previous = calloc(snd->channels, sizeof(long long));
+	if(!snd->sampleData || !buffer || !previous){
+		sndFail(SND_ERR_MEMORY, "error allocating memory for sample data.\n");
+	}
+	
+	int pos = 0;
+	int length = 0;
+	int channel = 0;
+	long i;
+	for(i = 0; i < count; i++){
+		uint64_t bits = 0;
+		int shift = 0;
+		unsigned char byte;
+		do {
+			if(pos == length){
+				length = fread(buffer, 1, READ_BLOCK, snd->stream);
+				pos = 0;
+				if(length == 0){
+					sndFail(SND_ERR_DATA, "found end of file before was specified\n");
+				}
+			}
+			byte = buffer[pos++];
+			if(shift > 63){
+				sndFail(SND_ERR_DATA, "found a value that is too long in the sample data\n");
+			}
+			bits |= (uint64_t)(byte & 0x7F) << shift;
+			shift += 7;
+		} while(byte & 0x80);
+		
+		long long value = (long long)(bits >> 1) ^ -(long long)(bits & 1);
+		if(delta){
+			value += previous[channel];
+			previous[channel] = value;
+			channel = (channel + 1 == snd->channels) ? 0 : channel + 1;
+		}
+		if(value < lower || value > upper){
+			sndFail(SND_ERR_DATA, "found sample beyond excepted bit depth limits %lld\n", value);
+		}
+		writeSample(snd->sampleData, width, i, (int)value);
+	}
+	checkCs229bEnd(snd, pos < length || fgetc(snd->stream) != EOF);
+	free(previous);
+	free(buffer);
+}
+
+/**
+*	Checks raw samples against the bit depth, which only 24 bit samples, kept in 4 bytes, can be past
+*/
+void checkRawCs229b(soundfile_t *snd){
+	if(snd->bitDepth != 24){
+		return;
+	}
+	const int32_t *samples = snd->sampleData;
+	long count = (long)snd->samples * snd->channels;
+	long i;
+	for(i = 0; i < count; i++){
+		if(samples[i] < -(1 << 23) || samples[i] > (1 << 23) - 1){
+			sndFail(SND_ERR_DATA, "found sample beyond excepted bit depth limits %d\n", samples[i]);
+		}
+	}
+}
+
+/**
+*	Fails if the file did not end where Samples said the samples do. unread is what was left after them, or
+*	how much was missing if it is negative
+*/
+void checkCs229bEnd(soundfile_t *snd, long unread){
+	if(unread < 0){
+		sndFail(SND_ERR_DATA, "found end of file before was specified\n");
+	} else if(unread > 0){
+		sndFail(SND_ERR_DATA, "specified number of samples, %d, did not match read number of samples\n", snd->samples);
+	}
+}
+
+/**
+*	Copies mapped samples into memory of their own, for changes that grow or shrink them
+*/
+void ownCs229b(soundfile_t *snd){
+	if(!snd->mapped){
+		return;
+	}
+	long numBytes = (long)snd->samples * snd->channels * sampleWidth(snd->bitDepth);
+	void *data = malloc(numBytes + 1);
+	if(!data){
+		sndFail(SND_ERR_MEMORY, "error allocating memory for sample data.\n");
+	}
+	memcpy(data, snd->sampleData, numBytes);
+	munmap(snd->mapped, snd->mappedSize);
+	snd->mapped = NULL;
+	snd->sampleData = data;
+}
+
+/**
+*	Frees the samples of a CS229B file, unmapping them if they were mapped
+*/
+void freeCs229b(soundfile_t *snd){
+	if(snd->mapped){
+		munmap(snd->mapped, snd->mappedSize);
+		snd->mapped = NULL;
+	} else {
+		free(snd->sampleData);
+	}
+	snd->sampleData = NULL;
+}
+
+/**
+*	Writes a whole CS229B file in the coding of from
+*/
+void writeCs229b(soundfile_t *from, FILE *to){
+	writeCs229bHeader(from, to);
+	int *previous = NULL; /* the last value written of each channel, carried from block to block */
+	if(from->coding == SND_CODING_DELTA){
+		previous = calloc(from->channels, sizeof(int));
+		if(!previous){
+			sndFail(SND_ERR_MEMORY, "error allocating memory for sample data.\n");
+		}
+	}
+	int numBlocks = (from->samples + BLOCK_FRAMES - 1) / BLOCK_FRAMES;
+	int block;
+	for(block = 0; block < numBlocks; block++){
+		int numFrames = from->samples - block*BLOCK_FRAMES;
+		if(numFrames > BLOCK_FRAMES){
+			numFrames = BLOCK_FRAMES;
+		}
+		writeCs229bFrames(from, frameBlock(from, block), numFrames, previous, to);
+	}
+	free(previous);
+}
+
+/**
+*	Write everything of a CS229B file up to the sample data, sized for from->samples. A comment is added
+*	before StartData when it is needed to make the header a multiple of CS229B_ALIGN long
+*/
+void writeCs229bHeader(soundfile_t *from, FILE *to){
+	const char *codings[] = { "raw", "varint", "delta" };
+	const uint16_t one = 1;
+	char header[256 + CS229B_ALIGN];
+	int length = snprintf(header, 256, "CS229B\n\nSampleRate %lu\nSamples %d\nBitDepth %d\nChannels %d\nCoding %s\nEndian %s\n\n",
+		from->sampleRate, from->samples, from->bitDepth, from->channels, codings[from->coding],
+		(*(const uint8_t *)&one == 1) ? "little" : "big");
+	int pad = (CS229B_ALIGN - (length + 10) % CS229B_ALIGN) % CS229B_ALIGN; /* "StartData\n" is 10 */
+	if(pad == 1){ /* the shortest comment is "#\n" */
+		pad += CS229B_ALIGN;
+	}
+	if(pad > 0){
+		header[length] = '#';
+		memset(header + length + 1, ' ', pad - 2);
+		header[length + pad - 1] = '\n';
+		length += pad;
+	}
+	fwrite(header, 1, length, to);
+	fwrite("StartData\n", 1, 10, to);
+}
+
+/**
+*	Write numFrames frames of CS229B sample data in the coding of from. Raw frames are written as they are kept.
+*	Delta coded frames need previous, the last value written of each channel, which is updated;
+*	so they are only written by writeCs229b, and the other writers, which may start anywhere, cannot
+*/
+void writeCs229bFrames(soundfile_t *from, const void *data, int numFrames, int *previous, FILE *to){
+	int width = sampleWidth(from->bitDepth);
+	long count = (long)numFrames * from->channels;
+	if(from->coding == SND_CODING_RAW){
+		fwrite(data, width, count, to);
+		return;
+	} else if(from->coding == SND_CODING_DELTA && !previous){
+		sndFail(SND_ERR_ARGUMENT, "delta coded CS229B files can only be written whole\n");
+	}
+	
+	unsigned char *buffer = malloc(WRITE_BLOCK + 10); /* a 64 bit value takes at most 10 bytes */
+	if(!buffer){
+		sndFail(SND_ERR_MEMORY, "error allocating memory for sample data.\n");
+	}
+	unsigned char *end = buffer;
+	int channel = 0;
+	long i;
+	for(i = 0; i < count; i++){
+		long long value = readSample(data, width, i);
+		if(previous){
+			long long next = value;
+			value -= previous[channel];
+			previous[channel] = next;
+			channel = (channel + 1 == from->channels) ? 0 : channel + 1;
+		}
+		uint64_t bits = ((uint64_t)value << 1) ^ (uint64_t)(value >> 63); /* zigzag */
+		while(bits >= 0x80){
+			*end++ = (bits & 0x7F) | 0x80;
+			bits >>= 7;
+		}
+		*end++ = bits;
+		if(end - buffer >= WRITE_BLOCK){
+			fwrite(buffer, 1, end - buffer, to);
+			end = buffer;
+		}
+	}
+	fwrite(buffer, 1, end - buffer, to);
+	free(buffer);
+}
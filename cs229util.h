@@ -5,12 +5,54 @@
 
 #include "sndutil.h"
 
+#define READ_BLOCK 65536 /* bytes the tokenizer reads at a time */
+#define CS229B_ALIGN 16 /* the header of a CS229B file is padded so its samples start at a multiple of this */
+
+typedef struct {
+	FILE *stream; /* the file being read */
+	char *buffer; /* the current block of the stream */
+	int pos; /* next unread byte of buffer */
+	int length; /* bytes in buffer */
+	long bytesRead; /* total bytes read from the stream */
+	long start; /* stream position the tokenizer started at */
+} tokenizer_t;
+
 void parseCs229(soundfile_t *snd);
+void probeCs229(soundfile_t *snd);
 void parseHeader(soundfile_t *snd);
 int parseKeywordValue(FILE *stream, int isSamples);
 void parseNewLine(int isComment, FILE *stream);
 void parseData(soundfile_t *snd);
+void countData(soundfile_t *snd);
+void cutCs229Stream(int low[], int high[], int numRestrictions, soundfile_t *snd, FILE *to);
+int readCs229Frames(tokenizer_t *tok, soundfile_t *snd, void *data, int numFrames);
+const char *parseBlock(tokenizer_t *tok, soundfile_t *snd, void *data, int numFrames);
+int indexCs229(soundfile_t *snd);
+const char *fillCs229Block(soundfile_t *snd, int block, void *data);
+void freeCs229Index(soundfile_t *snd);
+void initTokenizer(tokenizer_t *tok, FILE *stream);
+void freeTokenizer(tokenizer_t *tok);
+int fillTokenizer(tokenizer_t *tok);
+int nextInt(tokenizer_t *tok, long long *value);
+long tokenOffset(tokenizer_t *tok);
 
 void writeCs229(soundfile_t *from, FILE* to);
+void writeCs229Header(soundfile_t *from, FILE* to);
+void writeCs229Frames(soundfile_t *from, const void *data, int numFrames, FILE *to);
+
+void parseCs229b(soundfile_t *snd);
+void probeCs229b(soundfile_t *snd);
+int parseCoding(FILE *stream);
+int parseEndian(FILE *stream);
+int mapCs229b(soundfile_t *snd);
+void readRawCs229b(soundfile_t *snd);
+void readCodedCs229b(soundfile_t *snd);
+void checkRawCs229b(soundfile_t *snd);
+void checkCs229bEnd(soundfile_t *snd, long unread);
+void ownCs229b(soundfile_t *snd);
+void freeCs229b(soundfile_t *snd);
+void writeCs229b(soundfile_t *from, FILE *to);
+void writeCs229bHeader(soundfile_t *from, FILE *to);
+void writeCs229bFrames(soundfile_t *from, const void *data, int numFrames, int *previous, FILE *to);
 
 #endif
\ No newline at end of file
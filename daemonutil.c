@@ -0,0 +1,561 @@
+/* Author: Seth George */
+
+#define _GNU_SOURCE /* for struct ucred */
+#include "daemonutil.h"
+#include "aiffutil.h"
+#include "cs229util.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+char listening[sizeof(((struct sockaddr_un *)0)->sun_path)]; /* the socket, removed when the daemon stops */
+
+/**
+*	Writes the socket to use when neither -s nor SNDD_SOCKET gives one into path, which holds MAX_SOCKET_PATH.
+*	It is SOCKET_NAME in XDG_RUNTIME_DIR, or else in SOCKET_DIRECTORY, which is made if create is set.
+*	Either way it is somewhere only this user can get into, and a directory in /tmp that is not is refused
+*/
+void defaultSocket(char *path, int create){
+	const char *runtime = getenv("XDG_RUNTIME_DIR");
+	if(runtime && runtime[0] == '/'){
+		if(snprintf(path, MAX_SOCKET_PATH, "%s/%s", runtime, SOCKET_NAME) >= MAX_SOCKET_PATH){
+			fprintf(stderr, "Error: socket path in %s is too long\n", runtime);
+			exit(EXIT_FAILURE);
+		}
+		return;
+	}
+	
+	char directory[64];
+	snprintf(directory, sizeof(directory), SOCKET_DIRECTORY, (int)getuid());
+	if(create && mkdir(directory, 0700) != 0 && errno != EEXIST){
+		fprintf(stderr, "Error: could not make %s: %s\n", directory, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	struct stat info;
+	if(lstat(directory, &info) == 0){
+		if(!S_ISDIR(info.st_mode) || info.st_uid != getuid() || (info.st_mode & 077)){ /* someone else got there first */
+			fprintf(stderr, "Error: %s is not a directory only this user can use\n", directory);
+			exit(EXIT_FAILURE);
+		}
+	} else if(create){
+		fprintf(stderr, "Error: could not make %s: %s\n", directory, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	snprintf(path, MAX_SOCKET_PATH, "%s/%s", directory, SOCKET_NAME);
+}
+
+/**
+*	Returns 1 if the process at the other end of the connected socket fd runs as this user.
+*	Descriptors are only passed between the two when it does
+*/
+int peerIsUser(int fd){
+	struct ucred peer;
+	socklen_t length = sizeof(peer);
+	return getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &peer, &length) == 0 && peer.uid == getuid();
+}
+
+/**
+*	Listens on the UNIX socket at path and runs the requests of each client that connects,
+*	on numThreads workers that are started once and keep their handles and buffers between requests.
+*	Runs until it is stopped by SIGINT or SIGTERM
+*/
+void serveSocket(char *path, int numThreads){
+	int listener = listenOn(path);
+	signal(SIGPIPE, SIG_IGN); /* a client that goes away only fails its own request */
+	signal(SIGINT, stopDaemon);
+	signal(SIGTERM, stopDaemon);
+	
+	daemonpool_t pool;
+	memset(&pool, 0, sizeof(pool));
+	pthread_mutex_init(&pool.lock, NULL);
+	pthread_cond_init(&pool.ready, NULL);
+	pthread_cond_init(&pool.space, NULL);
+	int i;
+	for(i = 0; i < numThreads; i++){
+		daemonworker_t *worker = malloc(sizeof(daemonworker_t));
+		if(!worker){
+			fprintf(stderr, "Error: error allocating memory for the workers.\n");
+			exit(EXIT_FAILURE);
+		}
+		worker->pool = &pool;
+		worker->handle = sndOpen(NULL);
+		worker->next = sndOpen(NULL);
+		worker->inBuffer = malloc(READ_BLOCK);
+		worker->outBuffer = malloc(WRITE_BLOCK);
+		if(!worker->handle || !worker->next || !worker->inBuffer || !worker->outBuffer){
+			fprintf(stderr, "Error: error allocating memory for the workers.\n");
+			exit(EXIT_FAILURE);
+		}
+		
+		pthread_t thread;
+		if(pthread_create(&thread, NULL, daemonWorker, worker) != 0){
+			fprintf(stderr, "Error: could not start a worker thread\n");
+			exit(EXIT_FAILURE);
+		}
+		pthread_detach(thread);
+	}
+	fprintf(stderr, "sndd listening on %s with %d threads\n", path, numThreads);
+	
+	for(;;){
+		int client = accept(listener, NULL, NULL);
+		if(client < 0){ /* interrupted, or the client already went away */
+			continue;
+		}
+		if(!peerIsUser(client)){ /* only the user running the daemon may have files opened with their permissions */
+			close(client);
+			continue;
+		}
+		struct timeval timeout = { REQUEST_TIMEOUT, 0 };
+		setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+		pushConnection(&pool, client);
+	}
+}
+
+/**
+*	Makes the socket at path and listens on it. A socket left there by a daemon that is no longer running
+*	is replaced. Only the user running the daemon may connect, as the files are opened with their permissions
+*/
+int listenOn(char *path){
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if(strlen(path) >= sizeof(address.sun_path)){
+		fprintf(stderr, "Error: socket path %s is too long\n", path);
+		exit(EXIT_FAILURE);
+	}
+	strcpy(address.sun_path, path);
+	
+	int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(listener < 0){
+		fprintf(stderr, "Error: could not make a socket: %s\n", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	mode_t mask = umask(0077);
+	int bound = bind(listener, (struct sockaddr *)&address, sizeof(address));
+	if(bound != 0 && errno == EADDRINUSE){
+		int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+		if(connect(probe, (struct sockaddr *)&address, sizeof(address)) == 0){
+			fprintf(stderr, "Error: sndd is already running on %s\n", path);
+			exit(EXIT_FAILURE);
+		}
+		close(probe);
+		unlink(path); /* nothing answers, so it was left behind */
+		bound = bind(listener, (struct sockaddr *)&address, sizeof(address));
+	}
+	umask(mask);
+	if(bound != 0 || listen(listener, MAX_WAITING) != 0){
+		fprintf(stderr, "Error: could not listen on %s: %s\n", path, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	strcpy(listening, path);
+	return listener;
+}
+
+/**
+*	Removes the socket and exits, on SIGINT or SIGTERM
+*/
+void stopDaemon(int sig){
+	(void)sig; /* the same for both */
+	unlink(listening);
+	_exit(0);
+}
+
+/**
+*	Adds an accepted connection for a worker to take, waiting while MAX_WAITING are already waiting
+*/
+void pushConnection(daemonpool_t *pool, int fd){
+	pthread_mutex_lock(&pool->lock);
+	while(pool->count == MAX_WAITING){
+		pthread_cond_wait(&pool->space, &pool->lock);
+	}
+	pool->waiting[(pool->first + pool->count) % MAX_WAITING] = fd;
+	pool->count++;
+	pthread_cond_signal(&pool->ready);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+/**
+*	Takes the connection that has waited longest, waiting until there is one
+*/
+int popConnection(daemonpool_t *pool){
+	pthread_mutex_lock(&pool->lock);
+	while(pool->count == 0){
+		pthread_cond_wait(&pool->ready, &pool->lock);
+	}
+	int fd = pool->waiting[pool->first];
+	pool->first = (pool->first + 1) % MAX_WAITING;
+	pool->count--;
+	pthread_cond_signal(&pool->space);
+	pthread_mutex_unlock(&pool->lock);
+	return fd;
+}
+
+/**
+*	Serves one connection after another
+*/
+void *daemonWorker(void *arg){
+	daemonworker_t *worker = arg;
+	for(;;){
+		int fd = popConnection(worker->pool);
+		serveClient(worker, fd);
+		close(fd);
+	}
+	return NULL;
+}
+
+/**
+*	Receives a request, runs it on the client's own streams and sends back the status it would have exited with.
+*	The streams are closed before the status is sent, so everything written is there when the client exits
+*/
+void serveClient(daemonworker_t *worker, int fd){
+	request_t *request = &worker->request;
+	if(!receiveRequest(fd, request)){
+		return;
+	}
+	FILE *in = fdopen(request->fds[1], "r");
+	FILE *out = fdopen(request->fds[2], "w");
+	FILE *err = fdopen(request->fds[3], "w");
+	int status = EXIT_FAILURE;
+	if(in && out && err){
+		setvbuf(in, worker->inBuffer, _IOFBF, READ_BLOCK);
+		setvbuf(out, worker->outBuffer, _IOFBF, WRITE_BLOCK);
+		setvbuf(err, NULL, _IONBF, 0); /* like standard error */
+		status = runRequest(worker, request, in, out, err);
+		sndClear(worker->handle); /* the sounds are freed, the handles are kept for the next request */
+		sndClear(worker->next);
+	}
+	
+	int i;
+	FILE *streams[REQUEST_FDS] = { NULL, in, out, err };
+	for(i = 0; i < REQUEST_FDS; i++){
+		if(streams[i]){
+			fclose(streams[i]);
+		} else {
+			close(request->fds[i]);
+		}
+	}
+	send(fd, &status, sizeof(status), MSG_NOSIGNAL);
+}
+
+/**
+*	Reads a request and the descriptors passed with it. Returns 1 if it is whole and well formed,
+*	otherwise closes any descriptors that came with it and returns 0
+*/
+int receiveRequest(int fd, request_t *request){
+	requestheader_t header;
+	char control[CMSG_SPACE(REQUEST_FDS * sizeof(int))];
+	struct iovec part = { &header, sizeof(header) };
+	struct msghdr message;
+	memset(&message, 0, sizeof(message));
+	message.msg_iov = &part;
+	message.msg_iovlen = 1;
+	message.msg_control = control;
+	message.msg_controllen = sizeof(control);
+	
+	ssize_t got = recvmsg(fd, &message, MSG_CMSG_CLOEXEC);
+	int numFds = 0;
+	struct cmsghdr *passed = (got > 0) ? CMSG_FIRSTHDR(&message) : NULL;
+	if(passed && passed->cmsg_level == SOL_SOCKET && passed->cmsg_type == SCM_RIGHTS){
+		numFds = (passed->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+		memcpy(request->fds, CMSG_DATA(passed), numFds * sizeof(int));
+	}
+	int valid = (got > 0 && numFds == REQUEST_FDS && !(message.msg_flags & MSG_CTRUNC));
+	if(valid && got < (ssize_t)sizeof(header)){ /* the rest of the header came after the descriptors */
+		valid = readFully(fd, (char *)&header + got, sizeof(header) - got);
+	}
+	valid = valid && header.magic == REQUEST_MAGIC && header.argc > 0 && header.argc <= MAX_REQUEST_ARGS
+		&& header.length > 0 && header.length <= MAX_REQUEST_LENGTH && readFully(fd, request->args, header.length)
+		&& request->args[header.length - 1] == '\0';
+	
+	request->argc = 0;
+	int i;
+	for(i = 0; valid && i < header.length; i += strlen(request->args + i) + 1){ /* split the arguments at each '\0' */
+		if(request->argc == header.argc){
+			valid = 0;
+		} else {
+			request->argv[request->argc++] = request->args + i;
+		}
+	}
+	request->argv[request->argc] = NULL;
+	if(!valid || request->argc != header.argc){
+		for(i = 0; i < numFds; i++){
+			close(request->fds[i]);
+		}
+		return 0;
+	}
+	return 1;
+}
+
+/**
+*	Reads size bytes from fd. Returns 0 if it ends or fails first
+*/
+int readFully(int fd, void *data, size_t size){
+	size_t done = 0;
+	while(done < size){
+		ssize_t got = recv(fd, (char *)data + done, size - done, 0);
+		if(got <= 0){
+			return 0;
+		}
+		done += got;
+	}
+	return 1;
+}
+
+/**
+*	Runs the command a request names, "info", "conv", "cut" or "cat", with or without "snd" in front,
+*	as the program of that name would run with the same arguments. Returns the status it would exit with
+*/
+int runRequest(daemonworker_t *worker, request_t *request, FILE *in, FILE *out, FILE *err){
+	int argc = request->argc;
+	char **argv = request->argv;
+	int i;
+	for(i = 1; i < argc; i++){
+		if(strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "-1") == 0 || strcmp(argv[i], "--stats") == 0){
+			fprintf(err, "Error: %s is not supported by sndd, run %s itself\n", argv[i], argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	
+	char *command = argv[0];
+	if(strncmp(command, "snd", 3) == 0){
+		command += 3;
+	}
+	if(strcmp(command, "info") == 0){
+		return runInfo(worker, argc, argv, request->fds[0], in, out, err);
+	} else if(strcmp(command, "conv") == 0){
+		return runConv(worker, argc, argv, in, out, err);
+	} else if(strcmp(command, "cut") == 0){
+		return runCut(worker, argc, argv, in, out, err);
+	} else if(strcmp(command, "cat") == 0){
+		return runCat(worker, argc, argv, request->fds[0], in, out, err);
+	}
+	fprintf(err, "Error: unknown command %s\n", argv[0]);
+	return EXIT_FAILURE;
+}
+
+/**
+*	Opens path for reading, relative to the client's working directory cwd
+*/
+FILE *openAt(int cwd, char *path){
+	int fd = openat(cwd, path, O_RDONLY | O_CLOEXEC);
+	if(fd < 0){
+		return NULL;
+	}
+	FILE *stream = fdopen(fd, "r");
+	if(!stream){
+		close(fd);
+	}
+	return stream;
+}
+
+/**
+*	sndinfo: prints the stats of each file named, or of the input if none are
+*/
+int runInfo(daemonworker_t *worker, int argc, char **argv, int cwd, FILE *in, FILE *out, FILE *err){
+	int fullParse = 0; /* flag for decoding all the sample data */
+	int numFiles = 0;
+	int code;
+	int i;
+	for(i = 1; i < argc; i++){
+		if(strcmp(argv[i], "-f") == 0){ /* decode the files in full */
+			fullParse = 1;
+		
+		} else { /* a file name */
+			FILE *stream = openAt(cwd, argv[i]);
+			if(!stream){
+				fprintf(err, "Error: no such file\n");
+				return EXIT_FAILURE;
+			}
+			code = fullParse ? sndRead(worker->handle, stream, argv[i]) : sndProbe(worker->handle, stream, argv[i]);
+			fclose(stream);
+			if(sndPrintError(worker->handle, code, out, err) != SND_OK){
+				return EXIT_FAILURE;
+			}
+			writeSndInfo(handleSound(worker->handle), out);
+			numFiles++;
+		}
+	}
+	
+	if(numFiles == 0){ /* if no files were given */
+		code = fullParse ? sndRead(worker->handle, in, "(standard input)") : sndProbe(worker->handle, in, "(standard input)");
+		if(sndPrintError(worker->handle, code, out, err) != SND_OK){
+			return EXIT_FAILURE;
+		}
+		writeSndInfo(handleSound(worker->handle), out);
+	}
+	fprintf(out, "----------------------------------------------------------------------\n");
+	return 0;
+}
+
+/**
+*	sndconv: converts the input to the other format, or to the one forced with -a, -c or -b
+*/
+int runConv(daemonworker_t *worker, int argc, char **argv, FILE *in, FILE *out, FILE *err){
+	int forceAIFF = 0;
+	int forceCS229 = 0;
+	int forceCS229B = 0;
+	int coding = SND_CODING_RAW;
+	int i;
+	for(i = 1; i < argc; i++){
+		if(strcmp(argv[i], "-a") == 0){
+			forceAIFF = 1;
+			forceCS229 = 0;
+			forceCS229B = 0;
+		} else if(strcmp(argv[i], "-c") == 0){
+			forceCS229 = 1;
+			forceAIFF = 0;
+			forceCS229B = 0;
+		} else if(strcmp(argv[i], "-b") == 0){
+			forceCS229B = 1;
+			forceAIFF = 0;
+			forceCS229 = 0;
+		} else if(strcmp(argv[i], "-e") == 0 && i + 1 < argc){
+			i++;
+			if(strcmp(argv[i], "raw") == 0){
+				coding = SND_CODING_RAW;
+			} else if(strcmp(argv[i], "varint") == 0){
+				coding = SND_CODING_VARINT;
+			} else if(strcmp(argv[i], "delta") == 0){
+				coding = SND_CODING_DELTA;
+			} else {
+				fprintf(err, "Error: -e must be followed by raw, varint or delta\n");
+				return EXIT_FAILURE;
+			}
+		} else {
+			fprintf(err, "Error: invalid argument");
+			return EXIT_FAILURE;
+		}
+	}
+	
+	sndhandle_t *handle = worker->handle;
+	if(sndPrintError(handle, sndRead(handle, in, "(standard input)"), out, err) != SND_OK){
+		return EXIT_FAILURE;
+	}
+	const char *format = "CS229";
+	if(forceCS229B){
+		format = "CS229B";
+		sndSetCoding(handle, coding);
+	} else if(!forceCS229 && ((strncmp(handleSound(handle)->format, "CS229", 5) == 0) || forceAIFF)){ /* CS229B goes to AIFF like CS229 */
+		format = "AIFF";
+	}
+	if(sndPrintError(handle, sndWrite(handle, out, format), out, err) != SND_OK){
+		return EXIT_FAILURE;
+	}
+	return 0;
+}
+
+/**
+*	sndcut: removes the low..high ranges of frames from the input, and writes it in the same format
+*/
+int runCut(daemonworker_t *worker, int argc, char **argv, FILE *in, FILE *out, FILE *err){
+	int low[argc];
+	int high[argc];
+	int i;
+	for(i = 1; i < argc; i++){
+		if(!parseRange(argv[i], &low[i - 1], &high[i - 1], err)){
+			return EXIT_FAILURE;
+		}
+	}
+	
+	sndhandle_t *handle = worker->handle;
+	if(sndPrintError(handle, sndRead(handle, in, "(standard input)"), out, err) != SND_OK
+		|| sndPrintError(handle, sndCut(handle, low, high, argc - 1), out, err) != SND_OK
+		|| sndPrintError(handle, sndWrite(handle, out, NULL), out, err) != SND_OK){
+		return EXIT_FAILURE;
+	}
+	return 0;
+}
+
+/**
+*	Reads a low..high range the way sndcut does. Returns 0 after printing the error if it is not one
+*/
+int parseRange(char *arg, int *low, int *high, FILE *err){
+	size_t j;
+	for(j = 0; j < strlen(arg); j++){ /* check that they are numbers or periods */
+		if(!((arg[j] >= '0' && arg[j] <= '9') || arg[j] == '.')){
+			fprintf(err, "Error: argument for range is not a number or is in incorrect format: %s\n", arg);
+			return 0;
+		}
+	}
+	
+	char *dot = strchr(arg, '.'); /* low is the value before .. */
+	if(!dot || dot[1] != '.'){
+		fprintf(err, "Error: invalid delimiter between extremes\n");
+		return 0;
+	}
+	*low = atoi(arg);
+	*high = atoi(dot + 2);
+	return 1;
+}
+
+/**
+*	sndcat: writes the frames of every file named, one after another, as a single file.
+*	The files are decoded into the worker's handles, rather than streamed, as the clips it is used for are small
+*/
+int runCat(daemonworker_t *worker, int argc, char **argv, int cwd, FILE *in, FILE *out, FILE *err){
+	int forceAIFF = 0;
+	int forceCS229 = 0;
+	int numFiles = 0;
+	sndhandle_t *handle = worker->handle;
+	int i;
+	for(i = 1; i < argc; i++){
+		if(strcmp(argv[i], "-a") == 0){
+			forceAIFF = 1;
+			forceCS229 = 0;
+		} else if(strcmp(argv[i], "-c") == 0){
+			forceCS229 = 1;
+			forceAIFF = 0;
+		} else if(strcmp(argv[i], "-j") == 0){ /* the workers already run at the same time, so the count is not used */
+			if(i + 1 >= argc || atoi(argv[i + 1]) < 1){
+				fprintf(err, "Error: -j must be followed by a number of threads of at least 1\n");
+				return EXIT_FAILURE;
+			}
+			i++;
+		} else { /* a file name */
+			FILE *stream = openAt(cwd, argv[i]);
+			if(!stream){
+				fprintf(err, "Error: invalid file argument, cannot be opened.\n");
+				return EXIT_FAILURE;
+			}
+			sndhandle_t *to = (numFiles == 0) ? handle : worker->next; /* the first file is read into handle, the rest added to it */
+			int code = sndRead(to, stream, argv[i]);
+			fclose(stream);
+			if(sndPrintError(to, code, out, err) != SND_OK){
+				return EXIT_FAILURE;
+			}
+			if(to != handle){
+				sndinfo_t first;
+				sndinfo_t added;
+				sndGetInfo(handle, &first);
+				sndGetInfo(to, &added);
+				if(first.sampleRate != added.sampleRate || first.bitDepth != added.bitDepth || first.channels != added.channels){
+					fprintf(err, "Error: input argument sample rate, bit depth, or channels did not match of first file");
+					return EXIT_FAILURE;
+				}
+				if(sndPrintError(handle, sndAppend(handle, to), out, err) != SND_OK){
+					return EXIT_FAILURE;
+				}
+			}
+			numFiles++;
+		}
+	}
+	
+	if(numFiles == 0){ /* if no files were specified */
+		if(sndPrintError(handle, sndRead(handle, in, "(standard input)"), out, err) != SND_OK){
+			return EXIT_FAILURE;
+		}
+	}
+	const char *format = "CS229";
+	if(!forceCS229 && ((strcmp(handleSound(handle)->format, "AIFF") == 0) || forceAIFF)){
+		format = "AIFF";
+	}
+	if(sndPrintError(handle, sndWrite(handle, out, format), out, err) != SND_OK){
+		return EXIT_FAILURE;
+	}
+	return 0;
+}
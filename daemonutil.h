@@ -0,0 +1,69 @@
+/* Author: Seth George */
+
+#ifndef DAEMONUTIL_H
+#define DAEMONUTIL_H
+
+#include "sndutil.h"
+#include <pthread.h>
+
+#define SOCKET_NAME "sndd.socket" /* made in XDG_RUNTIME_DIR when neither -s nor SNDD_SOCKET gives a socket */
+#define SOCKET_DIRECTORY "/tmp/sndd-%d" /* made for the user id instead when there is no XDG_RUNTIME_DIR */
+#define MAX_SOCKET_PATH 4096
+#define REQUEST_MAGIC 0x736e6464 /* "sndd" */
+#define REQUEST_FDS 4 /* the client's working directory, standard input, standard output and standard error */
+#define MAX_REQUEST_LENGTH 65536 /* bytes of arguments a request may carry */
+#define MAX_REQUEST_ARGS 1024
+#define MAX_WAITING 64 /* accepted connections waiting for a worker */
+#define REQUEST_TIMEOUT 10 /* seconds a client has to send its request once connected */
+
+typedef struct {
+	int magic;
+	int argc; /* the command, then its arguments */
+	int length; /* bytes of the arguments that follow, each ending in '\0' */
+} requestheader_t;
+
+typedef struct {
+	int fds[REQUEST_FDS]; /* passed with the header */
+	int argc;
+	char *argv[MAX_REQUEST_ARGS + 1];
+	char args[MAX_REQUEST_LENGTH];
+} request_t;
+
+typedef struct {
+	int waiting[MAX_WAITING]; /* accepted connections, oldest at first */
+	int first;
+	int count;
+	pthread_mutex_t lock;
+	pthread_cond_t ready; /* signalled when a connection is added */
+	pthread_cond_t space; /* signalled when one is taken */
+} daemonpool_t;
+
+typedef struct {
+	daemonpool_t *pool;
+	sndhandle_t *handle; /* kept open from one request to the next */
+	sndhandle_t *next; /* the files sndcat adds to handle */
+	char *inBuffer; /* stdio buffers of the client's streams, also kept */
+	char *outBuffer;
+	request_t request;
+} daemonworker_t;
+
+void defaultSocket(char *path, int create);
+int peerIsUser(int fd);
+void serveSocket(char *path, int numThreads);
+int listenOn(char *path);
+void stopDaemon(int sig);
+void pushConnection(daemonpool_t *pool, int fd);
+int popConnection(daemonpool_t *pool);
+void *daemonWorker(void *arg);
+void serveClient(daemonworker_t *worker, int fd);
+int receiveRequest(int fd, request_t *request);
+int readFully(int fd, void *data, size_t size);
+int runRequest(daemonworker_t *worker, request_t *request, FILE *in, FILE *out, FILE *err);
+FILE *openAt(int cwd, char *path);
+int runInfo(daemonworker_t *worker, int argc, char **argv, int cwd, FILE *in, FILE *out, FILE *err);
+int runConv(daemonworker_t *worker, int argc, char **argv, FILE *in, FILE *out, FILE *err);
+int runCut(daemonworker_t *worker, int argc, char **argv, FILE *in, FILE *out, FILE *err);
+int parseRange(char *arg, int *low, int *high, FILE *err);
+int runCat(daemonworker_t *worker, int argc, char **argv, int cwd, FILE *in, FILE *out, FILE *err);
+
+#endif
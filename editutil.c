@@ -2,118 +2,928 @@
 
 #include "editutil.h"
 #include "sndutil.h"
+#include "aiffutil.h"
+#include "cs229util.h"
 #include <ncurses.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <sys/stat.h>
 
 /**
-*	Prints the sample data
+*	Print the side bar in sndedit, only the lines that changed since it was last drawn
 */
-void printBarCurses(int value, int bitDepth){
-	int max = power(2, bitDepth -1)-1; /* maximum possible value for bit depth */
-	int sign = 1;
-	if(value < 0) {
-		sign = -1;
+void printSideMenu(soundfile_t *snd, int mark, int inBuffer, int isModified, journal_t *journal, loader_t *loader, saver_t *saver, screen_t *screen){
+	char line[64];
+	int i;
+	int hrs, mins;
+	float secs = ((float)snd->samples)/snd->sampleRate;
+	hrs = secs/3600;
+	secs -= hrs*3600;
+	mins = secs/60;
+	secs -= mins*60;
+	
+	/* beginning of the side info */
+	snprintf(line, sizeof(line), " Sample Rate: %lu", snd->sampleRate);
+	menuLine(screen, 2, COLS-20, line);
+	snprintf(line, sizeof(line), " Bit Depth: %d", snd->bitDepth);
+	menuLine(screen, 3, COLS-20, line);
+	snprintf(line, sizeof(line), " Channels: %d", snd->channels);
+	menuLine(screen, 4, COLS-20, line);
+	snprintf(line, sizeof(line), " Samples: %d         ", snd->samples);
+	menuLine(screen, 5, COLS-20, line);
+	snprintf(line, sizeof(line), " Length: %d:%d:%.2f   ", hrs, mins, secs);
+	menuLine(screen, 6, COLS-20, line);
+	menuLine(screen, 7, COLS-21, "====================="); /* extra in case of odd rounding */
+	if(snd->samples <= 0) {
+		menuLine(screen, 8, COLS-20, "           ");
+		menuLine(screen, 9, COLS-20, "                   "); /* overwriting with spaces makes so I don't need to refresh */
+		menuLine(screen, 10, COLS-20, "                   ");
+		menuLine(screen, LINES-2, COLS-20, "                   ");
+	} else if(mark != -1){ /* marked index */
+		menuLine(screen, 8, COLS-20, "  m: unmark");
+		menuLine(screen, 9, COLS-20, "  c: copy");
+		menuLine(screen, 10, COLS-20, "  x: cut");
+		snprintf(line, sizeof(line), "  Marked: %d", mark);
+		menuLine(screen, LINES-2, COLS-20, line);
+	} else {
+		menuLine(screen, 8, COLS-20, "  m: mark  ");
+		menuLine(screen, 9, COLS-20, "                   "); /* overwriting with spaces makes so I don't need to refresh */
+		menuLine(screen, 10, COLS-20, "                   ");
+		menuLine(screen, LINES-2, COLS-20, "                   ");
+	}
+	
+	if(snd->samples <= 0) {
+		menuLine(screen, 11, COLS-20, "                   ");
+		menuLine(screen, 12, COLS-20, "                   ");
+		menuLine(screen, LINES-1, COLS-20, "                   ");
+	} else if(inBuffer){ /* if stuff is the buffer, we can also use it as a flag */
+		menuLine(screen, 11, COLS-20, "  ^: insert before");
+		menuLine(screen, 12, COLS-20, "  v: insert after");
+		snprintf(line, sizeof(line), " Buffered: %d", inBuffer/snd->channels);
+		menuLine(screen, LINES-1, COLS-20, line);
+	} else {
+		menuLine(screen, 11, COLS-20, "                   ");
+		menuLine(screen, 12, COLS-20, "                   ");
+		menuLine(screen, LINES-1, COLS-20, "                   ");
+	}
+	
+	int saved = savePercent(saver);
+	if(saved >= 0){ /* while the save thread writes */
+		snprintf(line, sizeof(line), "  Saving: %d%%      ", saved);
+		menuLine(screen, 13, COLS-20, line);
+	} else if(isModified && saver->failed){
+		menuLine(screen, 13, COLS-20, "  s: save (failed) ");
+	} else if(isModified){
+		menuLine(screen, 13, COLS-20, "  s: save          ");
+	} else {
+		menuLine(screen, 13, COLS-20, "                   ");
+	}
+	
+	if(journal->numEdits > 0 && journal->numEdits < journal->total){
+		menuLine(screen, 14, COLS-20, "  u: undo  r: redo ");
+	} else if(journal->numEdits > 0){
+		menuLine(screen, 14, COLS-20, "  u: undo          ");
+	} else if(journal->numEdits < journal->total){
+		menuLine(screen, 14, COLS-20, "  r: redo          ");
+	} else {
+		menuLine(screen, 14, COLS-20, "                   ");
 	}
 	
-	float ratio = (float)value*sign / max; /* ratio equals value / max value, rounding up as .5 */
-	int avalible = (COLS-32)/2;
-	int dashes = ratio * avalible + 0.5f;
+	menuLine(screen, 15, COLS-20, "  q: quit");
+	menuLine(screen, 16, COLS-20, " Movement:");
+	menuLine(screen, 17, COLS-20, "  up/down");
+	menuLine(screen, 18, COLS-20, "  pgup/pgdn");
+	menuLine(screen, 19, COLS-20, "  g: goto");
 	
+	int percent = loaderProgress(loader);
+	const char *error = (percent < 0) ? loaderError(loader) : NULL;
+	for(i = 20; i < LINES-3; i++){ /* fill in the every below with empty space */
+		if(i == 20 && error){ /* the samples could not be read, so they are shown as 0 */
+			menuLine(screen, i, COLS-20, " Loading failed:   ");
+		} else if(i > 20 && error && *error){ /* why, in pieces that fit the menu */
+			snprintf(line, sizeof(line), "  %-17.17s", error);
+			menuLine(screen, i, COLS-20, line);
+			error += (strlen(error) < 17) ? strlen(error) : 17;
+		} else if(i == 20 && percent < 100){ /* until the background thread is through the file */
+			snprintf(line, sizeof(line), " Loading: %d%%     ", percent);
+			menuLine(screen, i, COLS-20, line);
+		} else {
+			menuLine(screen, i, COLS-20, "                   ");
+		}
+	}
+	menuLine(screen, LINES-3, COLS-21, "====================="); /* extra in case of odd rounding */
+}
+
+/**
+*	Starts a screen with nothing drawn on it yet, then lays it out
+*/
+void initScreen(screen_t *screen, char *title){
+	screen->pane = NULL;
+	screen->rows = 0;
+	screen->lines = 0;
+	screen->cols = 0;
+	screen->start = 0;
+	screen->frames = NULL;
+	screen->values = NULL;
+	screen->reverse = NULL;
+	screen->blank = NULL;
+	screen->menu = NULL;
+	screen->title = title;
+	layoutScreen(screen);
+}
+
+/**
+*	Clears the screen and makes the pane for the current LINES and COLS, everything but the title and
+*	border is then drawn by the next printSideMenu and drawPane
+*/
+void layoutScreen(screen_t *screen){
 	int i;
-	if(value < 0){ /* if negative */
-		for(i = 0; i < avalible - dashes; i++){
-			printw(" ");
+	if(screen->menu){
+		for(i = 0; i < screen->lines; i++){
+			free(screen->menu[i]);
 		}
-		for(i = 0; i < dashes; i++){
-			printw("-");
+	}
+	if(screen->pane){
+		delwin(screen->pane);
+	}
+	clear();
+	
+	screen->lines = LINES;
+	screen->cols = COLS;
+	screen->rows = LINES - 2;
+	screen->width = 12 + ((COLS-32)/2)*2; /* index and pipe, then the bar */
+	screen->pane = newwin(screen->rows, screen->width, 2, 0);
+	keypad(screen->pane, TRUE);
+	idlok(screen->pane, TRUE); /* let curses scroll the terminal instead of redrawing the rows */
+	
+	screen->frames = realloc(screen->frames, screen->rows * sizeof(int));
+	screen->values = realloc(screen->values, screen->rows * sizeof(int));
+	screen->reverse = realloc(screen->reverse, screen->rows);
+	for(i = 0; i < screen->rows; i++){
+		screen->frames[i] = UNKNOWN_ROW;
+	}
+	screen->blank = realloc(screen->blank, screen->width + 1);
+	memset(screen->blank, ' ', screen->width - 1);
+	screen->blank[screen->width - 1] = '|';
+	screen->blank[screen->width] = '\0';
+	screen->menu = realloc(screen->menu, LINES * sizeof(char *));
+	for(i = 0; i < LINES; i++){
+		screen->menu[i] = NULL;
+	}
+	
+	mvprintw(0, (COLS - strlen(screen->title))/2, "%s", screen->title); /* print out title */
+	move(1, 0);
+	for(i = 0; i < COLS; i++){
+		addch('='); /* top === border thing */
+	}
+}
+
+/**
+*	Frees the pane and what was kept of it
+*/
+void freeScreen(screen_t *screen){
+	int i;
+	for(i = 0; i < screen->lines; i++){
+		free(screen->menu[i]);
+	}
+	free(screen->menu);
+	free(screen->frames);
+	free(screen->values);
+	free(screen->reverse);
+	free(screen->blank);
+	delwin(screen->pane);
+}
+
+/**
+*	Prints a line of the side menu, unless it already shows that text
+*/
+void menuLine(screen_t *screen, int y, int x, const char *text){
+	if(screen->menu[y] && strcmp(screen->menu[y], text) == 0){
+		return;
+	}
+	mvprintw(y, x, "%s", text);
+	free(screen->menu[y]);
+	screen->menu[y] = strdup(text);
+}
+
+/**
+*	Has line y of the screen drawn again, after something else was printed over it
+*/
+void forgetLine(screen_t *screen, int y){
+	free(screen->menu[y]);
+	screen->menu[y] = NULL;
+	if(y >= 2){
+		touchline(screen->pane, y - 2, 1); /* the pane's text is the same, curses only has to put it back */
+	}
+}
+
+/**
+*	Moves the rows already drawn when the pane now starts at frame start. A move of less than a page
+*	scrolls the pane, so only the rows that came into view have to be drawn
+*/
+void scrollPane(screen_t *screen, int start, int channels){
+	int shift = (start - screen->start) * channels; /* rows the drawn frames move up */
+	screen->start = start;
+	if(shift == 0 || shift >= screen->rows || -shift >= screen->rows){
+		return; /* a jump of a page or more has every row drawn again anyway */
+	}
+	
+	scrollok(screen->pane, TRUE);
+	wscrl(screen->pane, shift);
+	scrollok(screen->pane, FALSE); /* a bar in the last column of the last row must not scroll */
+	
+	int kept = screen->rows - abs(shift);
+	int from = (shift > 0) ? shift : 0;
+	int to = (shift > 0) ? 0 : -shift;
+	memmove(screen->frames + to, screen->frames + from, kept * sizeof(int));
+	memmove(screen->values + to, screen->values + from, kept * sizeof(int));
+	memmove(screen->reverse + to, screen->reverse + from, kept);
+	
+	int i;
+	int first = (shift > 0) ? kept : 0; /* rows scrolled in are blank */
+	for(i = first; i < first + abs(shift); i++){
+		screen->frames[i] = UNKNOWN_ROW;
+	}
+}
+
+/**
+*	Prints one row of the pane, the index (on the first channel only) and the bar
+*/
+void drawRow(screen_t *screen, int row, int frame, int channel, int value, int reverse, int bitDepth){
+	WINDOW *pane = screen->pane;
+	wmove(pane, row, 0);
+	if(reverse){
+		wattron(pane, A_REVERSE); /* reverse video */
+	}
+	
+	if(frame == BLANK_ROW){
+		waddnstr(pane, screen->blank, screen->width);
+	} else {
+		char index[16];
+		if(channel == 0){
+			snprintf(index, sizeof(index), "%9d|", frame); /* the number should be "right justified" */
+		} else {
+			strcpy(index, "         |"); /* for multiple channels, we don't show a number */
 		}
-		printw("|");
-		for(i = 0; i < avalible; i++){
-			printw(" ");
+		waddstr(pane, index);
+		
+		int length;
+		const char *bar = barFor(value, bitDepth, COLS-20, &length);
+		waddnstr(pane, bar, length - 1);
+	}
+	
+	wattroff(pane, A_REVERSE); /* un-reverse video*/
+	screen->frames[row] = frame;
+	screen->values[row] = value;
+	screen->reverse[row] = reverse;
+}
+
+/**
+*	Prints the rows of the pane that changed since they were drawn, for the frames from start on.
+*	Frames from low to high are reversed when there is a mark
+*/
+void drawPane(screen_t *screen, piecetable_t *table, int start, int mark, int low, int high){
+	int channels = table->source.channels;
+	int row;
+	for(row = 0; row < screen->rows; row++){ /* row/channels is the sample being printed relative to the screen*/
+		int frame = start + row/channels;
+		int channel = row % channels;
+		int value = 0;
+		int reverse = 0;
+		if(frame < table->frames){
+			value = pieceSample(table, frame*channels + channel);
+			reverse = (mark != -1) && (frame >= low) && (frame <= high);
+		} else {
+			frame = BLANK_ROW; /* if we shouldn't print anything, print blank lines */
 		}
-	} else { /* else if positive */
-		for(i = 0; i < avalible; i++){
-			printw(" ");
+		
+		if(screen->frames[row] != frame || screen->values[row] != value || screen->reverse[row] != reverse){
+			drawRow(screen, row, frame, channel, value, reverse, table->source.bitDepth);
 		}
-		printw("|");
-		for(i = 0; i < dashes; i++){
-			printw("-");
+	}
+}
+
+/**
+*	Reads the header of snd, whose stream is just past its format identifier, and starts decoding its
+*	samples on a background thread into a block cache of budget bytes. An AIFF file is mapped and a CS229
+*	file is indexed, so the block that is shown can be decoded before the thread gets to it.
+*	A CS229 file without a Samples count, or that cannot seek, is read whole first
+*/
+void startLoader(loader_t *loader, soundfile_t *snd, long budget){
+	loader->isCs229 = (strcmp(snd->format, "CS229") == 0);
+	if(strcmp(snd->format, "CS229B") == 0){
+		parseCs229b(snd); /* raw samples are mapped, and used in place */
+	} else if(loader->isCs229){
+		parseHeader(snd);
+		if(!indexCs229(snd)){
+			parseData(snd);
 		}
-		for(i = 0; i < avalible - dashes; i++){
-			printw(" ");
+	} else if(!mapAiff(snd)){
+		parseAiff(snd); /* not a regular file, there is nothing to map */
+	}
+	
+	loader->numBlocks = (snd->samples + BLOCK_FRAMES - 1) / BLOCK_FRAMES;
+	loader->loaded = 0;
+	loader->running = 0;
+	loader->stop = 0;
+	loader->error = NULL;
+	initCache(&loader->cache, budget);
+	pthread_mutex_init(&loader->lock, NULL);
+	
+	if(snd->sampleData || snd->mapped){
+		fclose(snd->stream); /* a mapping stays valid without it */
+		snd->stream = NULL;
+	}
+	loader->snd = *snd;
+	if(snd->sampleData){ /* read whole, there is nothing left to decode */
+		loader->loaded = loader->numBlocks;
+	} else {
+		loader->running = 1;
+		if(pthread_create(&loader->thread, NULL, loadBlocks, loader) != 0){
+			fprintf(stderr, "Error: could not start a decoding thread\n");
+			exit(EXIT_FAILURE);
 		}
 	}
-	printw("|"); /* pipe at the end of the bar */
 }
 
 /**
-*	Print the side bar in sndedit
+*	The background thread, decodes the blocks from the front while the cache has room for them.
+*	Past that, it only reads through the rest of a CS229 file, so where each block starts is known
+*	and any errors are found. Errors are kept in the loader rather than ending the program from this thread
 */
-void printSideMenu(soundfile_t *snd, int mark, int inBuffer, int isModified){
-	int i;
-	for(i = 0; i < COLS; i++){
-		mvprintw(1, i, "="); /* top === border thing */
+void *loadBlocks(void *arg){
+	loader_t *loader = arg;
+	soundfile_t *snd = &loader->snd;
+	long size = (long)BLOCK_FRAMES * snd->channels * sampleWidth(snd->bitDepth);
+	void *scratch = malloc(size);
+	int block;
+	for(block = 0; block < loader->numBlocks; block++){
+		pthread_mutex_lock(&loader->lock);
+		if(loader->stop){
+			pthread_mutex_unlock(&loader->lock);
+			break;
+		}
+		
+		const char *error = NULL;
+		if(!cacheFull(&loader->cache, size)){
+			cachedBlock(&loader->cache, snd, block, &error);
+		} else if(!loader->isCs229){ /* the rest is decoded from the mapping as it is shown */
+			block = loader->numBlocks - 1;
+		} else if(block >= snd->numOffsets || block == loader->numBlocks - 1){ /* not read through yet, the last also checks the end */
+			error = fillBlock(snd, block, scratch);
+		}
+		loader->loaded = block + 1;
+		if(error){ /* a block shown or saved may have failed first, its error is kept */
+			loader->error = error;
+		}
+		pthread_mutex_unlock(&loader->lock);
+		if(error){
+			break;
+		}
+	}
+	free(scratch);
+	return NULL;
+}
+
+/**
+*	Returns the block of the loader's cache, decoding it into the cache first if it is not there.
+*	Returns NULL if the samples of the CS229 file are not valid, with why in the loader's error.
+*	Must be called with the lock held. The save thread gets here too, so the error is never reported from here
+*/
+const void *loaderBlock(loader_t *loader, int block){
+	const char *error = NULL;
+	const void *data = cachedBlock(&loader->cache, &loader->snd, block, &error);
+	if(!data){
+		loader->error = error;
+	}
+	return data;
+}
+
+/**
+*	Returns the value at index of a block of the original sample data, 0 if the block could not be read
+*/
+int loadSample(loader_t *loader, int block, int index){
+	soundfile_t *snd = &loader->snd;
+	int width = sampleWidth(snd->bitDepth);
+	if(snd->sampleData){
+		return readSample(snd->sampleData, width, block * BLOCK_FRAMES * snd->channels + index);
 	}
 	
-	int hrs, mins;
-	float secs = ((float)snd->samples)/snd->sampleRate;
-	hrs = secs/3600;
-	secs -= hrs*3600;
-	mins = secs/60;
-	secs -= mins*60;
+	pthread_mutex_lock(&loader->lock);
+	const void *data = loaderBlock(loader, block);
+	int value = data ? readSample(data, width, index) : 0;
+	pthread_mutex_unlock(&loader->lock);
+	return value;
+}
+
+/**
+*	Copies a block of the original sample data into to, which holds BLOCK_FRAMES frames.
+*	A copy, since the cache can drop the block as soon as the lock is let go. Returns 0 if the block could not be read
+*/
+int copyBlock(loader_t *loader, int block, void *to){
+	soundfile_t *snd = &loader->snd;
+	int frameBytes = snd->channels * sampleWidth(snd->bitDepth);
+	int frame = block * BLOCK_FRAMES;
+	int numFrames = (snd->samples - frame < BLOCK_FRAMES) ? snd->samples - frame : BLOCK_FRAMES;
+	if(snd->sampleData){
+		memcpy(to, (char *)snd->sampleData + (long)frame * frameBytes, (long)numFrames * frameBytes);
+		return 1;
+	}
 	
-	/* beginning of the side info */
-	mvprintw(2, COLS-20, " Sample Rate: %d", snd->sampleRate);
-	mvprintw(3, COLS-20, " Bit Depth: %d", snd->bitDepth);
-	mvprintw(4, COLS-20, " Channels: %d", snd->channels);
-	mvprintw(5, COLS-20, " Samples: %d         ", snd->samples);
-	mvprintw(6, COLS-20, " Length: %d:%d:%.2f   ", hrs, mins, secs);
-	mvprintw(7, COLS-21, "====================="); /* extra in case of odd rounding */
-	if(snd->samples <= 0) {
-		mvprintw(8, COLS-20, "           ");
-		mvprintw(9, COLS-20, "                   "); /* overwriting with spaces makes so I don't need to refresh */
-		mvprintw(10, COLS-20, "                   ");
-		mvprintw(LINES-2, COLS-20, "                   ");
-	} else if(mark != -1){ /* marked index */
-		mvprintw(8, COLS-20, "  m: unmark");
-		mvprintw(9, COLS-20, "  c: copy");
-		mvprintw(10, COLS-20, "  x: cut");
-		mvprintw(LINES-2, COLS-20, "  Marked: %d", mark);
-	} else {
-		mvprintw(8, COLS-20, "  m: mark  ");
-		mvprintw(9, COLS-20, "                   "); /* overwriting with spaces makes so I don't need to refresh */
-		mvprintw(10, COLS-20, "                   ");
-		mvprintw(LINES-2, COLS-20, "                   ");
+	pthread_mutex_lock(&loader->lock);
+	const void *data = loaderBlock(loader, block);
+	if(data){
+		memcpy(to, data, (long)numFrames * frameBytes);
+	}
+	pthread_mutex_unlock(&loader->lock);
+	return data != NULL;
+}
+
+/**
+*	Returns the percent of the blocks the background thread has been through, -1 once samples were found not to be valid
+*/
+int loaderProgress(loader_t *loader){
+	pthread_mutex_lock(&loader->lock);
+	int percent = (loader->numBlocks > 0) ? (int)((long)loader->loaded * 100 / loader->numBlocks) : 100;
+	if(loader->error){
+		percent = -1;
+	}
+	pthread_mutex_unlock(&loader->lock);
+	return percent;
+}
+
+/**
+*	Returns why the samples could not be read, NULL if they could
+*/
+const char *loaderError(loader_t *loader){
+	pthread_mutex_lock(&loader->lock);
+	const char *error = loader->error;
+	pthread_mutex_unlock(&loader->lock);
+	return error;
+}
+
+/**
+*	Stops the background thread and frees the decoded blocks
+*/
+void freeLoader(loader_t *loader){
+	pthread_mutex_lock(&loader->lock);
+	loader->stop = 1;
+	pthread_mutex_unlock(&loader->lock);
+	if(loader->running){
+		pthread_join(loader->thread, NULL);
+		loader->running = 0;
 	}
 	
-	if(snd->samples <= 0) {
-		mvprintw(11, COLS-20, "                   ");
-		mvprintw(12, COLS-20, "                   ");
-		mvprintw(LINES-1, COLS-20, "                   ");
-	} else if(inBuffer){ /* if stuff is the buffer, we can also use it as a flag */
-		mvprintw(11, COLS-20, "  ^: insert before");
-		mvprintw(12, COLS-20, "  v: insert after");
-		mvprintw(LINES-1, COLS-20, " Buffered: %d", inBuffer/snd->channels);
+	freeCache(&loader->cache);
+	if(strcmp(loader->snd.format, "CS229B") == 0){
+		freeCs229b(&loader->snd); /* raw samples are used in place in the mapping */
+	} else {
+		free(loader->snd.sampleData);
+	}
+	freeCs229Index(&loader->snd);
+	unmapAiff(&loader->snd);
+	if(loader->snd.stream){
+		fclose(loader->snd.stream);
+	}
+	pthread_mutex_destroy(&loader->lock);
+}
+
+/**
+*	Starts with no save running
+*/
+void initSaver(saver_t *saver){
+	saver->running = 0;
+	saver->done = 0;
+	saver->failed = 0;
+	saver->written = 0;
+	pthread_mutex_init(&saver->lock, NULL);
+}
+
+/**
+*	Starts writing the edited sound to a temporary file next to the original on a background thread.
+*	The pieces are copied first, so the table can be edited while the save runs
+*/
+void startSave(saver_t *saver, piecetable_t *table, soundfile_t *edited){
+	saver->edited = *edited;
+	initPieces(&saver->table, &table->source);
+	copyPieces(table, 0, table->frames - 1, &saver->table);
+	saver->table.loader = table->loader;
+	saver->written = 0;
+	saver->done = 0;
+	saver->failed = 0;
+	saver->running = 1;
+	if(pthread_create(&saver->thread, NULL, saveFile, saver) != 0){
+		fprintf(stderr, "Error: could not start a saving thread\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+/**
+*	The save thread, writes the pieces to the temporary file, flushes it to the disk, then renames it
+*	over the original. The original is never opened for writing, so a crash mid save leaves it as it was
+*/
+void *saveFile(void *arg){
+	saver_t *saver = arg;
+	int failed = 0;
+	snprintf(saver->temp, sizeof(saver->temp), "%s.XXXXXX", saver->edited.name);
+	int fd = mkstemp(saver->temp);
+	FILE *to = (fd != -1) ? fdopen(fd, "w") : NULL;
+	if(!to){
+		if(fd != -1){
+			close(fd);
+			unlink(saver->temp);
+		}
+		failed = 1;
 	} else {
-		mvprintw(11, COLS-20, "                   ");
-		mvprintw(12, COLS-20, "                   ");
-		mvprintw(LINES-1, COLS-20, "                   ");
+		struct stat info;
+		if(stat(saver->edited.name, &info) == 0){
+			fchmod(fd, info.st_mode & 07777); /* mkstemp makes it readable only by its owner */
+		}
+		if(!writePieces(&saver->table, &saver->edited, to, savedFrames, saver)){ /* the samples could not be read */
+			failed = 1;
+		}
+		if(fflush(to) != 0 || ferror(to) || fsync(fd) != 0){
+			failed = 1;
+		}
+		if(fclose(to) != 0){
+			failed = 1;
+		}
+		if(failed || rename(saver->temp, saver->edited.name) != 0){
+			unlink(saver->temp);
+			failed = 1;
+		}
+	}
+	
+	if(!failed){ /* make the rename itself last too */
+		char dir[MAX_NAME_LENGTH];
+		strcpy(dir, saver->edited.name);
+		int dirFd = open(dirname(dir), O_RDONLY);
+		if(dirFd != -1){
+			fsync(dirFd);
+			close(dirFd);
+		}
 	}
 	
-	if(isModified){
-		mvprintw(13, COLS-20, "  s: save");
+	pthread_mutex_lock(&saver->lock);
+	saver->failed = failed;
+	saver->done = 1;
+	pthread_mutex_unlock(&saver->lock);
+	return NULL;
+}
+
+/**
+*	Counts the frames writePieces has written, for the progress in the side menu
+*/
+void savedFrames(void *arg, int numFrames){
+	saver_t *saver = arg;
+	pthread_mutex_lock(&saver->lock);
+	saver->written += numFrames;
+	pthread_mutex_unlock(&saver->lock);
+}
+
+/**
+*	Returns the percent of the frames the running save has written, -1 if there is no save running
+*/
+int savePercent(saver_t *saver){
+	if(!saver->running){
+		return -1;
+	}
+	pthread_mutex_lock(&saver->lock);
+	int percent = (saver->table.frames > 0) ? (int)((long)saver->written * 100 / saver->table.frames) : 100;
+	pthread_mutex_unlock(&saver->lock);
+	return percent;
+}
+
+/**
+*	Joins the save thread once it is through, or waits for it if wait is set.
+*	Returns 1 if the file was replaced, -1 if it could not be, and 0 if the save is still running or there is none
+*/
+int endSave(saver_t *saver, int wait){
+	if(!saver->running){
+		return 0;
+	}
+	pthread_mutex_lock(&saver->lock);
+	int done = saver->done;
+	pthread_mutex_unlock(&saver->lock);
+	if(!done && !wait){
+		return 0;
+	}
+	
+	pthread_join(saver->thread, NULL);
+	saver->running = 0;
+	freePieces(&saver->table);
+	return saver->failed ? -1 : 1;
+}
+
+/**
+*	Starts a piece table holding all of snd's frames as one piece
+*/
+void initPieces(piecetable_t *table, soundfile_t *snd){
+	table->source = *snd;
+	table->capacity = 16;
+	table->pieces = malloc(table->capacity * sizeof(piece_t));
+	table->ends = malloc(table->capacity * sizeof(int));
+	table->numPieces = 0;
+	table->frames = 0;
+	table->loader = NULL;
+	if(snd->samples > 0){
+		piece_t whole = {0, snd->samples};
+		insertPieces(table, 0, &whole, 1);
+	}
+}
+
+/**
+*	Frees the pieces, the original sample data belongs to the soundfile_t it came from
+*/
+void freePieces(piecetable_t *table){
+	free(table->pieces);
+	free(table->ends);
+	table->pieces = NULL;
+	table->ends = NULL;
+	table->numPieces = 0;
+	table->frames = 0;
+}
+
+/**
+*	Binary search for the piece holding frame, numPieces if frame is past the end
+*/
+int findPiece(piecetable_t *table, int frame){
+	int low = 0;
+	int high = table->numPieces;
+	while(low < high){
+		int middle = (low + high) / 2;
+		if(table->ends[middle] > frame){
+			high = middle;
+		} else {
+			low = middle + 1;
+		}
+	}
+	return low;
+}
+
+/**
+*	Splits the piece holding frame so that a piece starts at frame, returns the index of that piece
+*/
+int splitPiece(piecetable_t *table, int frame){
+	int i = findPiece(table, frame);
+	if(i >= table->numPieces){
+		return table->numPieces;
+	}
+	
+	int pieceStart = table->ends[i] - table->pieces[i].length;
+	if(pieceStart == frame){
+		return i;
+	}
+	
+	piece_t tail = {table->pieces[i].start + (frame - pieceStart), table->ends[i] - frame};
+	table->pieces[i].length = frame - pieceStart;
+	table->ends[i] = frame;
+	insertPieces(table, i + 1, &tail, 1);
+	return i + 1;
+}
+
+/**
+*	Inserts numPieces pieces before the piece at index at
+*/
+void insertPieces(piecetable_t *table, int at, piece_t *pieces, int numPieces){
+	if(table->numPieces + numPieces > table->capacity){
+		while(table->numPieces + numPieces > table->capacity){
+			table->capacity *= 2;
+		}
+		table->pieces = realloc(table->pieces, table->capacity * sizeof(piece_t));
+		table->ends = realloc(table->ends, table->capacity * sizeof(int));
+	}
+	
+	memmove(table->pieces + at + numPieces, table->pieces + at, (table->numPieces - at) * sizeof(piece_t));
+	memcpy(table->pieces + at, pieces, numPieces * sizeof(piece_t));
+	table->numPieces += numPieces;
+	updateEnds(table, at);
+}
+
+/**
+*	Recomputes the ends of the pieces from index from on, and the total frames
+*/
+void updateEnds(piecetable_t *table, int from){
+	int end = (from > 0) ? table->ends[from - 1] : 0;
+	int i;
+	for(i = from; i < table->numPieces; i++){
+		end += table->pieces[i].length;
+		table->ends[i] = end;
+	}
+	table->frames = end;
+}
+
+/**
+*	Returns the sample data of a block of the original frames. From the loader it is copied into scratch,
+*	which holds BLOCK_FRAMES frames. Returns NULL if the loader could not read it
+*/
+const void *sourceBlock(piecetable_t *table, int block, void *scratch){
+	if(table->loader){
+		return copyBlock(table->loader, block, scratch) ? scratch : NULL;
+	}
+	return frameBlock(&table->source, block);
+}
+
+/**
+*	Returns the value at index of the edited sample data, index counts every channel like getSample
+*/
+int pieceSample(piecetable_t *table, int index){
+	int channels = table->source.channels;
+	int frame = index / channels;
+	int i = findPiece(table, frame);
+	int offset = frame - (table->ends[i] - table->pieces[i].length);
+	int source = table->pieces[i].start + offset; /* the frame in the original sample data */
+	if(table->loader){
+		int block = source / BLOCK_FRAMES;
+		return loadSample(table->loader, block, (source - block*BLOCK_FRAMES) * channels + index % channels);
+	}
+	return getSample(&table->source, source * channels + index % channels);
+}
+
+/**
+*	Replaces the pieces of clip with the pieces covering frames [low..high] of table, no samples are copied
+*/
+void copyPieces(piecetable_t *table, int low, int high, piecetable_t *clip){
+	clip->numPieces = 0;
+	clip->frames = 0;
+	
+	int i = findPiece(table, low);
+	while(i < table->numPieces && low <= high){
+		int pieceStart = table->ends[i] - table->pieces[i].length;
+		int last = (table->ends[i] - 1 < high) ? table->ends[i] - 1 : high;
+		piece_t part = {table->pieces[i].start + (low - pieceStart), last - low + 1};
+		insertPieces(clip, clip->numPieces, &part, 1);
+		low = last + 1;
+		i++;
+	}
+}
+
+/**
+*	Removes frames [low..high] from the edited sound
+*/
+void cutPieces(piecetable_t *table, int low, int high){
+	int first = splitPiece(table, low);
+	int last = splitPiece(table, high + 1); /* the piece after the cut */
+	memmove(table->pieces + first, table->pieces + last, (table->numPieces - last) * sizeof(piece_t));
+	table->numPieces -= last - first;
+	updateEnds(table, first);
+}
+
+/**
+*	Inserts the pieces of clip so that they start at insertFrame
+*/
+void pastePieces(piecetable_t *table, int insertFrame, piecetable_t *clip){
+	int at = splitPiece(table, insertFrame);
+	insertPieces(table, at, clip->pieces, clip->numPieces);
+}
+
+/**
+*	Writes the edited sound in the format of edited, streaming each piece from the original sample data.
+*	Returns 0, leaving the file part written, if a block of the original could not be read
+*/
+int writePieces(piecetable_t *table, soundfile_t *edited, FILE *to, void (*progress)(void *arg, int numFrames), void *arg){
+	int isCs229 = (strcmp(edited->format, "CS229") == 0);
+	int isCs229b = (strcmp(edited->format, "CS229B") == 0);
+	int *previous = NULL; /* delta coded CS229B carries the last value of each channel from piece to piece */
+	int frameBytes = table->source.channels * sampleWidth(table->source.bitDepth);
+	if(isCs229b){
+		writeCs229bHeader(edited, to);
+		if(edited->coding == SND_CODING_DELTA){
+			previous = calloc(edited->channels, sizeof(int));
+		}
+	} else if(isCs229){
+		writeCs229Header(edited, to);
 	} else {
-		mvprintw(13, COLS-20, "                   ");
+		writeAiffHeader(edited, to);
+	}
+	
+	void *scratch = malloc((long)BLOCK_FRAMES * frameBytes);
+	int written = 1;
+	int i;
+	for(i = 0; i < table->numPieces && written; i++){
+		int frame = table->pieces[i].start;
+		int left = table->pieces[i].length;
+		while(left > 0){ /* a block at a time, the way the source is decoded */
+			int block = frame / BLOCK_FRAMES;
+			int numFrames = (block + 1) * BLOCK_FRAMES - frame;
+			if(numFrames > left){
+				numFrames = left;
+			}
+			
+			const char *data = sourceBlock(table, block, scratch);
+			if(!data){
+				written = 0;
+				break;
+			}
+			data += (frame - block*BLOCK_FRAMES) * frameBytes;
+			if(isCs229b){
+				writeCs229bFrames(edited, data, numFrames, previous, to);
+			} else if(isCs229){
+				writeCs229Frames(edited, data, numFrames, to);
+			} else {
+				writeAiffFrames(edited, data, numFrames, to);
+			}
+			if(progress){
+				progress(arg, numFrames);
+			}
+			frame += numFrames;
+			left -= numFrames;
+		}
+	}
+	free(scratch);
+	free(previous);
+	return written;
+}
+
+/**
+*	Starts an empty journal of edits
+*/
+void initJournal(journal_t *journal){
+	journal->capacity = 16;
+	journal->edits = malloc(journal->capacity * sizeof(edit_t));
+	journal->numEdits = 0;
+	journal->total = 0;
+}
+
+/**
+*	Frees every recorded edit
+*/
+void freeJournal(journal_t *journal){
+	int i;
+	for(i = 0; i < journal->total; i++){
+		free(journal->edits[i].pieces);
+	}
+	free(journal->edits);
+	journal->edits = NULL;
+	journal->numEdits = 0;
+	journal->total = 0;
+}
+
+/**
+*	Records a cut of frames [low..high], before it is made, or a paste into frames [low..high], after it is made.
+*	Only the pieces of the range are kept, never the samples, and the edits that could be redone are dropped
+*/
+void recordEdit(journal_t *journal, piecetable_t *table, int isCut, int low, int high){
+	int i;
+	for(i = journal->numEdits; i < journal->total; i++){
+		free(journal->edits[i].pieces);
 	}
+	journal->total = journal->numEdits;
 	
-	mvprintw(14, COLS-20, "  q: quit");
-	mvprintw(15, COLS-20, "");
-	mvprintw(16, COLS-20, " Movement:");
-	mvprintw(17, COLS-20, "  up/down");
-	mvprintw(18, COLS-20, "  pgup/pgdn");
-	mvprintw(19, COLS-20, "  g: goto");
+	if(journal->total == journal->capacity){
+		journal->capacity *= 2;
+		journal->edits = realloc(journal->edits, journal->capacity * sizeof(edit_t));
+	}
 	
-	for(i = 20; i < LINES-3; i++){ /* fill in the every below with empty space */
-		mvprintw(i, COLS-20, "                   ");
+	piecetable_t range; /* copyPieces fills a table, only its pieces are kept */
+	range.capacity = 4;
+	range.pieces = malloc(range.capacity * sizeof(piece_t));
+	range.ends = malloc(range.capacity * sizeof(int));
+	range.numPieces = 0;
+	copyPieces(table, low, high, &range);
+	free(range.ends);
+	
+	edit_t *edit = &journal->edits[journal->total];
+	edit->isCut = isCut;
+	edit->frame = low;
+	edit->frames = high - low + 1;
+	edit->pieces = range.pieces;
+	edit->numPieces = range.numPieces;
+	journal->total++;
+	journal->numEdits++;
+}
+
+/**
+*	Reverses the last edit that was not undone, returns 0 if there is none
+*/
+int undoEdit(journal_t *journal, piecetable_t *table){
+	if(journal->numEdits == 0){
+		return 0;
+	}
+	
+	edit_t *edit = &journal->edits[--journal->numEdits];
+	if(edit->isCut){ /* put the cut pieces back */
+		insertPieces(table, splitPiece(table, edit->frame), edit->pieces, edit->numPieces);
+	} else {
+		cutPieces(table, edit->frame, edit->frame + edit->frames - 1);
+	}
+	return 1;
+}
+
+/**
+*	Makes the last undone edit again, returns 0 if there is none
+*/
+int redoEdit(journal_t *journal, piecetable_t *table){
+	if(journal->numEdits == journal->total){
+		return 0;
+	}
+	
+	edit_t *edit = &journal->edits[journal->numEdits++];
+	if(edit->isCut){
+		cutPieces(table, edit->frame, edit->frame + edit->frames - 1);
+	} else { /* paste the pieces again */
+		insertPieces(table, splitPiece(table, edit->frame), edit->pieces, edit->numPieces);
 	}
-	mvprintw(LINES-3, COLS-21, "====================="); /* extra in case of odd rounding */
+	return 1;
 }
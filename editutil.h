@@ -4,9 +4,132 @@
 #define EDITUTIL_H
 
 #include "sndutil.h"
+#include "cs229util.h"
 #include <ncurses.h>
+#include <pthread.h>
 
-void printBarCurses(int value, int bitDepth);
-void printSideMenu(soundfile_t *snd, int mark, int inBuffer, int isModified);
+typedef struct {
+	soundfile_t snd; /* the sound being loaded, with the stream or mapping its samples come from */
+	blockcache_t cache; /* the decoded blocks of BLOCK_FRAMES frames, held to a budget */
+	int numBlocks;
+	int loaded; /* blocks the background thread has been through */
+	int isCs229; /* a CS229 file is read through to index it, an AIFF file is decoded from its mapping */
+	int running; /* 1 while the background thread has to be joined */
+	int stop; /* set to end the background thread early */
+	const char *error; /* why the CS229 data could not be read, NULL if it could */
+	pthread_t thread;
+	pthread_mutex_t lock; /* held around the cache and the stream */
+} loader_t;
+
+typedef struct {
+	int start; /* first frame of the piece in the original sample data */
+	int length; /* frames in the piece */
+} piece_t;
+
+typedef struct {
+	soundfile_t source; /* the sound as it was opened, its sample data is never modified */
+	piece_t *pieces; /* runs of the original frames, in the order they are in the edited sound */
+	int *ends; /* frames up to the end of each piece, searched to find the piece holding a frame */
+	int numPieces;
+	int capacity; /* pieces allocated */
+	int frames; /* frames in the edited sound */
+	loader_t *loader; /* where the blocks of source are decoded, NULL if its sample data was read whole */
+} piecetable_t;
+
+typedef struct {
+	int isCut; /* 1 if the edit removed frames, 0 if it pasted them */
+	int frame; /* first frame removed or pasted */
+	int frames; /* frames removed or pasted */
+	piece_t *pieces; /* the frames removed or pasted, as pieces of the original sample data */
+	int numPieces;
+} edit_t;
+
+typedef struct {
+	edit_t *edits; /* oldest first */
+	int numEdits; /* edits that can be undone, the ones after them can be redone */
+	int total; /* edits recorded */
+	int capacity; /* edits allocated */
+} journal_t;
+
+#define BLANK_ROW -1 /* frame of a pane row past the end of the sound */
+#define UNKNOWN_ROW -2 /* frame of a pane row whose contents have to be drawn again */
+
+typedef struct {
+	piecetable_t table; /* the pieces as they were when the save started, later edits go into the next save */
+	soundfile_t edited; /* header of the saved sound */
+	char temp[MAX_NAME_LENGTH + 8]; /* the file being written, renamed over edited.name once it is complete */
+	int written; /* frames written so far */
+	int running; /* 1 while the save thread has to be joined */
+	int done; /* set by the save thread when it is through */
+	int failed; /* 1 if the last save could not replace the file */
+	pthread_t thread;
+	pthread_mutex_t lock;
+} saver_t;
+
+typedef struct {
+	WINDOW *pane; /* the rows of sample bars, left of the side menu */
+	int rows; /* rows in the pane */
+	int width; /* columns in the pane, the length of one row of a bar */
+	int lines; /* LINES and COLS the screen was laid out for */
+	int cols;
+	int start; /* first frame of the pane when it was last drawn */
+	int *frames; /* frame drawn on each row of the pane, BLANK_ROW or UNKNOWN_ROW */
+	int *values; /* sample drawn on each row of the pane */
+	char *reverse; /* 1 if the row was drawn in reverse video */
+	char *blank; /* a row past the end of the sound */
+	char **menu; /* text drawn on each line of the side menu, NULL if it has to be drawn again */
+	char *title;
+} screen_t;
+
+void printSideMenu(soundfile_t *snd, int mark, int inBuffer, int isModified, journal_t *journal, loader_t *loader, saver_t *saver, screen_t *screen);
+
+/* Screen Functions */
+void initScreen(screen_t *screen, char *title);
+void layoutScreen(screen_t *screen);
+void freeScreen(screen_t *screen);
+void menuLine(screen_t *screen, int y, int x, const char *text);
+void forgetLine(screen_t *screen, int y);
+void scrollPane(screen_t *screen, int start, int channels);
+void drawRow(screen_t *screen, int row, int frame, int channel, int value, int reverse, int bitDepth);
+void drawPane(screen_t *screen, piecetable_t *table, int start, int mark, int low, int high);
+
+/* Loader Functions */
+void startLoader(loader_t *loader, soundfile_t *snd, long budget);
+void *loadBlocks(void *arg);
+const void *loaderBlock(loader_t *loader, int block);
+int loadSample(loader_t *loader, int block, int index);
+int copyBlock(loader_t *loader, int block, void *to);
+int loaderProgress(loader_t *loader);
+const char *loaderError(loader_t *loader);
+void freeLoader(loader_t *loader);
+
+/* Save Functions */
+void initSaver(saver_t *saver);
+void startSave(saver_t *saver, piecetable_t *table, soundfile_t *edited);
+void *saveFile(void *arg);
+void savedFrames(void *arg, int numFrames);
+int savePercent(saver_t *saver);
+int endSave(saver_t *saver, int wait);
+
+/* Piece Table Functions */
+void initPieces(piecetable_t *table, soundfile_t *snd);
+void freePieces(piecetable_t *table);
+int findPiece(piecetable_t *table, int frame);
+int splitPiece(piecetable_t *table, int frame);
+void insertPieces(piecetable_t *table, int at, piece_t *pieces, int numPieces);
+void updateEnds(piecetable_t *table, int from);
+const void *sourceBlock(piecetable_t *table, int block, void *scratch);
+int pieceSample(piecetable_t *table, int index);
+void copyPieces(piecetable_t *table, int low, int high, piecetable_t *clip);
+void cutPieces(piecetable_t *table, int low, int high);
+void pastePieces(piecetable_t *table, int insertFrame, piecetable_t *clip);
+int writePieces(piecetable_t *table, soundfile_t *edited, FILE *to, void (*progress)(void *arg, int numFrames), void *arg);
+
+/* Undo Journal Functions */
+void initJournal(journal_t *journal);
+void freeJournal(journal_t *journal);
+void recordEdit(journal_t *journal, piecetable_t *table, int isCut, int low, int high);
+int undoEdit(journal_t *journal, piecetable_t *table);
+int redoEdit(journal_t *journal, piecetable_t *table);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,429 @@
+/* Author: Seth George */
+
+#include "aiffutil.h"
+#include "cs229util.h"
+#include "allocutil.h"
+
+struct sndhandle {
+	sndcontext_t context; /* everything the library allocated for the sound, and the last error */
+	soundfile_t snd;
+	int loaded; /* 1 once a header has been read */
+	int decoded; /* 1 once the sample data has been read */
+	int code; /* code of the last call */
+};
+
+/**
+*	Returns the sound of a handle, for the programs that print it as they always have
+*/
+soundfile_t *handleSound(sndhandle_t *handle){
+	return &handle->snd;
+}
+
+/**
+*	Frees the sound of a handle, leaving it as sndOpen made it
+*/
+void clearSound(sndhandle_t *handle){
+	if(handle->snd.mapped){ /* CS229B samples used in place */
+		freeCs229b(&handle->snd);
+	}
+	freeContext(&handle->context);
+	initSoundfile(&handle->snd);
+	handle->loaded = 0;
+	handle->decoded = 0;
+}
+
+/**
+*	Ends a call made in the handle's context. A read that failed, or any call that ran out of memory,
+*	may have left the sound half changed, so it is cleared. Returns code
+*/
+int leaveCall(sndhandle_t *handle, int code, int isRead){
+	leaveContext(&handle->context);
+	if(code == SND_ERR_MEMORY || (code != SND_OK && isRead)){
+		clearSound(handle);
+	}
+	handle->code = code;
+	return code;
+}
+
+/**
+*	Fails a call before it has entered the handle's context, keeping message as the error. Returns code
+*/
+int callError(sndhandle_t *handle, int code, const char *message){
+	strncpy(handle->context.message, message, MAX_ERROR_LENGTH - 1);
+	handle->context.message[MAX_ERROR_LENGTH - 1] = '\0';
+	handle->context.length = strlen(handle->context.message);
+	handle->context.out = stderr;
+	handle->context.newline = 1;
+	handle->code = code;
+	return code;
+}
+
+/**
+*	Makes a handle with no sound in it. Everything the library allocates for it comes from allocator,
+*	or from malloc if allocator is NULL. Returns NULL if the handle itself could not be allocated
+*/
+sndhandle_t *sndOpen(const sndallocator_t *allocator){
+	sndcontext_t context;
+	initContext(&context, allocator);
+	sndhandle_t *handle = context.allocator.malloc(sizeof(sndhandle_t), context.allocator.arg);
+	if(!handle){
+		return NULL;
+	}
+	
+	handle->context = context;
+	initSoundfile(&handle->snd);
+	handle->loaded = 0;
+	handle->decoded = 0;
+	handle->code = SND_OK;
+	return handle;
+}
+
+/**
+*	Frees a handle and everything allocated for it
+*/
+void sndClose(sndhandle_t *handle){
+	if(handle){
+		clearSound(handle);
+		handle->context.allocator.free(handle, handle->context.allocator.arg);
+	}
+}
+
+/**
+*	Frees the handle's sound, keeping the handle to read the next one into
+*/
+int sndClear(sndhandle_t *handle){
+	if(!handle){
+		return SND_ERR_ARGUMENT;
+	}
+	clearSound(handle);
+	handle->code = SND_OK;
+	return SND_OK;
+}
+
+/**
+*	Reads a sound from stream into the handle, replacing the one it had. Only the header is read unless decode is set.
+*	The stream is left open
+*/
+int readSound(sndhandle_t *handle, FILE *stream, const char *name, int decode){
+	if(!handle){
+		return SND_ERR_ARGUMENT;
+	}
+	clearSound(handle);
+	soundfile_t *snd = &handle->snd;
+	
+	int code = setjmp(handle->context.jump);
+	if(code == SND_OK){
+		enterContext(&handle->context);
+		snd->stream = stream;
+		strncpy(snd->name, name ? name : "(stream)", MAX_NAME_LENGTH - 1);
+		snd->name[MAX_NAME_LENGTH - 1] = '\0';
+		
+		setFormat(snd);
+		if(strcmp(snd->format, "CS229") == 0){
+			if(decode){
+				parseCs229(snd);
+			} else {
+				probeCs229(snd);
+			}
+		} else if(strcmp(snd->format, "CS229B") == 0){
+			if(decode){
+				parseCs229b(snd);
+			} else {
+				probeCs229b(snd);
+			}
+		} else {
+			if(decode){
+				parseAiff(snd);
+			} else {
+				probeAiff(snd);
+			}
+		}
+		snd->stream = NULL; /* the caller owns it */
+		snd->duration = ((float)snd->samples)/snd->sampleRate; /* duration in seconds */
+		handle->loaded = 1;
+		handle->decoded = decode;
+	}
+	return leaveCall(handle, code, 1);
+}
+
+/**
+*	Reads and decodes a whole AIFF or CS229 sound from stream, named name in errors and sndGetInfo
+*/
+int sndRead(sndhandle_t *handle, FILE *stream, const char *name){
+	return readSound(handle, stream, name, 1);
+}
+
+/**
+*	Reads only the header of a sound from stream, seeking past its sample data where it can
+*/
+int sndProbe(sndhandle_t *handle, FILE *stream, const char *name){
+	return readSound(handle, stream, name, 0);
+}
+
+/**
+*	Opens path, reads it with readSound and closes it
+*/
+int readPath(sndhandle_t *handle, const char *path, int decode){
+	if(!handle){
+		return SND_ERR_ARGUMENT;
+	}
+	FILE *stream = path ? fopen(path, "r") : NULL;
+	if(!stream){ /* invalid file pointer */
+		clearSound(handle);
+		return callError(handle, SND_ERR_IO, "no such file");
+	}
+	int code = readSound(handle, stream, path, decode);
+	fclose(stream);
+	return code;
+}
+
+/**
+*	Reads and decodes the sound in the file at path
+*/
+int sndReadFile(sndhandle_t *handle, const char *path){
+	return readPath(handle, path, 1);
+}
+
+/**
+*	Reads only the header of the sound in the file at path
+*/
+int sndProbeFile(sndhandle_t *handle, const char *path){
+	return readPath(handle, path, 0);
+}
+
+/**
+*	Writes the sound to a stream as "AIFF", "CS229" or "CS229B", or in the format it was read in if format is NULL.
+*	CS229B samples are stored in the coding given by sndSetCoding
+*/
+int sndWrite(sndhandle_t *handle, FILE *to, const char *format){
+	if(!handle){
+		return SND_ERR_ARGUMENT;
+	} else if(!handle->decoded){
+		return callError(handle, SND_ERR_ARGUMENT, "no sample data has been read to write");
+	} else if(!to){
+		return callError(handle, SND_ERR_ARGUMENT, "no stream to write to");
+	}
+	const char *volatile written = format ? format : handle->snd.format; /* kept across the setjmp, unlike the argument */
+	if(strcmp(written, "AIFF") != 0 && strcmp(written, "CS229") != 0 && strcmp(written, "CS229B") != 0){
+		return callError(handle, SND_ERR_ARGUMENT, "the format to write must be AIFF, CS229 or CS229B");
+	}
+	
+	int code = setjmp(handle->context.jump);
+	if(code == SND_OK){
+		enterContext(&handle->context);
+		if(strcmp(written, "AIFF") == 0){
+			writeAiff(&handle->snd, to);
+		} else if(strcmp(written, "CS229B") == 0){
+			writeCs229b(&handle->snd, to);
+		} else {
+			writeCs229(&handle->snd, to);
+		}
+		if(fflush(to) != 0 || ferror(to)){
+			sndFail(SND_ERR_IO, "could not write the file\n");
+		}
+	}
+	return leaveCall(handle, code, 0);
+}
+
+/**
+*	Sets how sndWrite stores the samples when it writes CS229B, one of the SND_CODING values.
+*	Reading a sound sets it to the coding the sound was read in, or SND_CODING_RAW
+*/
+int sndSetCoding(sndhandle_t *handle, int coding){
+	if(!handle){
+		return SND_ERR_ARGUMENT;
+	} else if(coding != SND_CODING_RAW && coding != SND_CODING_VARINT && coding != SND_CODING_DELTA){
+		return callError(handle, SND_ERR_ARGUMENT, "the coding must be SND_CODING_RAW, SND_CODING_VARINT or SND_CODING_DELTA");
+	}
+	handle->snd.coding = coding;
+	handle->code = SND_OK;
+	return SND_OK;
+}
+
+/**
+*	Removes the frames in each [low..high] range, including both ends. The ranges may be in any order and overlap
+*/
+int sndCut(sndhandle_t *handle, const int low[], const int high[], int numRanges){
+	if(!handle){
+		return SND_ERR_ARGUMENT;
+	} else if(!handle->decoded){
+		return callError(handle, SND_ERR_ARGUMENT, "no sample data has been read to cut");
+	} else if(numRanges < 0 || (numRanges > 0 && (!low || !high))){
+		return callError(handle, SND_ERR_ARGUMENT, "invalid ranges to cut");
+	}
+	
+	int code = setjmp(handle->context.jump);
+	if(code == SND_OK){
+		enterContext(&handle->context);
+		int i;
+		for(i = 0; i < numRanges; i++){
+			if(low[i] < 0){
+				sndFail(SND_ERR_ARGUMENT, "specified low value, %d, is negative\n", low[i]);
+			} else if(low[i] > high[i]){
+				sndFail(SND_ERR_ARGUMENT, "specified low value, %d, is greater than high value, %d\n", low[i], high[i]);
+			}
+		}
+		int *ranges = malloc(2 * (numRanges + 1) * sizeof(int)); /* sorted and merged in place, so the caller's are left alone */
+		memcpy(ranges, low, numRanges * sizeof(int));
+		memcpy(ranges + numRanges + 1, high, numRanges * sizeof(int));
+		int numMerged = mergeRanges(ranges, ranges + numRanges + 1, numRanges);
+		dataCut(ranges, ranges + numRanges + 1, numMerged, &handle->snd);
+		free(ranges);
+		handle->snd.duration = ((float)handle->snd.samples)/handle->snd.sampleRate;
+	}
+	return leaveCall(handle, code, 0);
+}
+
+/**
+*	Adds the frames of from to the end of the handle's sound. Their sample rate, bit depth and channels must match
+*/
+int sndAppend(sndhandle_t *handle, sndhandle_t *from){
+	if(!handle){
+		return SND_ERR_ARGUMENT;
+	} else if(!from || !handle->decoded || !from->decoded){
+		return callError(handle, SND_ERR_ARGUMENT, "no sample data has been read to append");
+	}
+	soundfile_t *snd = &handle->snd;
+	if(snd->sampleRate != from->snd.sampleRate || snd->bitDepth != from->snd.bitDepth || snd->channels != from->snd.channels){
+		return callError(handle, SND_ERR_ARGUMENT, "sample rate, bit depth, or channels did not match");
+	}
+	
+	int code = setjmp(handle->context.jump);
+	if(code == SND_OK){
+		enterContext(&handle->context);
+		int count = from->snd.samples * from->snd.channels;
+		void *buffer = from->snd.sampleData;
+		if(from == handle){ /* dataCat moves the sample data, so a sound is copied before it is added to itself */
+			buffer = malloc((long)count * sampleWidth(snd->bitDepth) + 1);
+			memcpy(buffer, from->snd.sampleData, (long)count * sampleWidth(snd->bitDepth));
+		}
+		dataCat(snd->samples, buffer, count, snd);
+		if(from == handle){
+			free(buffer);
+		}
+		snd->duration = ((float)snd->samples)/snd->sampleRate;
+	}
+	return leaveCall(handle, code, 0);
+}
+
+/**
+*	Fills info with the header of the handle's sound. Its name and format stay valid until the next read
+*/
+int sndGetInfo(sndhandle_t *handle, sndinfo_t *info){
+	if(!handle){
+		return SND_ERR_ARGUMENT;
+	} else if(!handle->loaded || !info){
+		return callError(handle, SND_ERR_ARGUMENT, "no sound has been read");
+	}
+	soundfile_t *snd = &handle->snd;
+	info->name = snd->name;
+	info->format = snd->format;
+	info->sampleRate = snd->sampleRate;
+	info->bitDepth = snd->bitDepth;
+	info->channels = snd->channels;
+	info->samples = snd->samples;
+	info->duration = snd->duration;
+	info->decoded = handle->decoded;
+	handle->code = SND_OK;
+	return SND_OK;
+}
+
+/**
+*	Checks that frame and channel are in the handle's decoded sound
+*/
+int checkPosition(sndhandle_t *handle, int frame, int channel){
+	if(!handle){
+		return SND_ERR_ARGUMENT;
+	} else if(!handle->decoded){
+		return callError(handle, SND_ERR_ARGUMENT, "no sample data has been read");
+	} else if(frame < 0 || frame >= handle->snd.samples || channel < 0 || channel >= handle->snd.channels){
+		return callError(handle, SND_ERR_ARGUMENT, "frame or channel is past the end of the sound");
+	}
+	return SND_OK;
+}
+
+/**
+*	Sets value to the sample of a channel at a frame
+*/
+int sndGetSample(sndhandle_t *handle, int frame, int channel, int *value){
+	int code = checkPosition(handle, frame, channel);
+	if(code == SND_OK){
+		*value = getSample(&handle->snd, frame * handle->snd.channels + channel);
+		handle->code = SND_OK;
+	}
+	return code;
+}
+
+/**
+*	Changes the sample of a channel at a frame, which must fit in the sound's bit depth
+*/
+int sndSetSample(sndhandle_t *handle, int frame, int channel, int value){
+	int code = checkPosition(handle, frame, channel);
+	if(code != SND_OK){
+		return code;
+	}
+	
+	code = setjmp(handle->context.jump);
+	if(code == SND_OK){
+		enterContext(&handle->context);
+		checkBitDepth(value, handle->snd.bitDepth);
+		setSample(&handle->snd, frame * handle->snd.channels + channel, value);
+	}
+	return leaveCall(handle, code, 0);
+}
+
+/**
+*	Returns the message of the handle's last error, or "" if its last call succeeded
+*/
+const char *sndError(sndhandle_t *handle){
+	if(!handle){
+		return "the handle could not be allocated";
+	}
+	return (handle->code == SND_OK) ? "" : handle->context.message;
+}
+
+/**
+*	Returns the name of an error code
+*/
+const char *sndErrorName(int code){
+	switch(code){
+		case SND_OK: return "SND_OK";
+		case SND_ERR_IO: return "SND_ERR_IO";
+		case SND_ERR_FORMAT: return "SND_ERR_FORMAT";
+		case SND_ERR_DATA: return "SND_ERR_DATA";
+		case SND_ERR_MEMORY: return "SND_ERR_MEMORY";
+		case SND_ERR_ARGUMENT: return "SND_ERR_ARGUMENT";
+	}
+	return "unknown error";
+}
+
+/**
+*	Prints the handle's error as "Error: " and the message, to out where the programs have always printed it
+*	to standard output and to err otherwise. Returns code, and prints nothing if it is SND_OK
+*/
+int sndPrintError(sndhandle_t *handle, int code, FILE *out, FILE *err){
+	if(code == SND_OK){
+		return code;
+	}
+	if(!handle){
+		fprintf(err, "Error: %s\n", sndError(handle));
+		return code;
+	}
+	FILE *to = (handle->context.out == stdout) ? out : err;
+	fprintf(to, "Error: ");
+	fwrite(handle->context.message, 1, handle->context.length, to);
+	if(handle->context.newline){
+		fprintf(to, "\n");
+	}
+	return code;
+}
+
+/**
+*	For programs that stop at the first error. Returns if code is SND_OK, otherwise prints the handle's error
+*	with sndPrintError to standard output or standard error and exits
+*/
+void sndExitOnError(sndhandle_t *handle, int code){
+	if(sndPrintError(handle, code, stdout, stderr) != SND_OK){
+		exit(EXIT_FAILURE);
+	}
+}
@@ -0,0 +1,69 @@
+/* Author: Seth George */
+
+#ifndef LIBSND_H
+#define LIBSND_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+/* What the library calls return */
+#define SND_OK 0
+#define SND_ERR_IO 1 /* a file could not be opened, mapped or written */
+#define SND_ERR_FORMAT 2 /* the file is not a valid AIFF or CS229 file */
+#define SND_ERR_DATA 3 /* the sample data does not match the header */
+#define SND_ERR_MEMORY 4 /* the allocator ran out */
+#define SND_ERR_ARGUMENT 5 /* the call was given something it cannot use */
+
+/* How sndWrite stores the samples of a CS229B file */
+#define SND_CODING_RAW 0 /* as they are kept in memory, in this machine's byte order, so they can be mapped and used in place */
+#define SND_CODING_VARINT 1 /* each value zigzag coded in as few bytes as it needs */
+#define SND_CODING_DELTA 2 /* the difference from the channel's value in the frame before, coded as varint */
+
+typedef struct {
+	void *(*malloc)(size_t size, void *arg);
+	void *(*realloc)(void *data, size_t size, void *arg); /* may be NULL, blocks are then moved with malloc and free */
+	void (*free)(void *data, void *arg);
+	void *arg; /* passed to each of them */
+} sndallocator_t;
+
+typedef struct {
+	const char *name; /* what the sound was read as */
+	const char *format; /* CS229, CS229B or AIFF */
+	int sampleRate;
+	int bitDepth;
+	int channels;
+	int samples; /* frames */
+	float duration; /* seconds */
+	int decoded; /* 1 if the samples were read, 0 if only the header was */
+} sndinfo_t;
+
+typedef struct sndhandle sndhandle_t;
+
+/**
+*	A handle holds one sound and everything the library allocated for it. A handle must only be used
+*	by one thread at a time, different handles may be used by different threads at once.
+*	Every call returns SND_OK or an error code, and sndError gives the message of the last error.
+*	A read that fails leaves the handle empty
+*/
+#pragma GCC visibility push(default) /* the library is built with -fvisibility=hidden, only these calls are exported */
+sndhandle_t *sndOpen(const sndallocator_t *allocator);
+void sndClose(sndhandle_t *handle);
+int sndClear(sndhandle_t *handle);
+int sndRead(sndhandle_t *handle, FILE *stream, const char *name);
+int sndReadFile(sndhandle_t *handle, const char *path);
+int sndProbe(sndhandle_t *handle, FILE *stream, const char *name);
+int sndProbeFile(sndhandle_t *handle, const char *path);
+int sndWrite(sndhandle_t *handle, FILE *to, const char *format);
+int sndSetCoding(sndhandle_t *handle, int coding);
+int sndCut(sndhandle_t *handle, const int low[], const int high[], int numRanges);
+int sndAppend(sndhandle_t *handle, sndhandle_t *from);
+int sndGetInfo(sndhandle_t *handle, sndinfo_t *info);
+int sndGetSample(sndhandle_t *handle, int frame, int channel, int *value);
+int sndSetSample(sndhandle_t *handle, int frame, int channel, int value);
+const char *sndError(sndhandle_t *handle);
+const char *sndErrorName(int code);
+int sndPrintError(sndhandle_t *handle, int code, FILE *out, FILE *err);
+void sndExitOnError(sndhandle_t *handle, int code);
+#pragma GCC visibility pop
+
+#endif
@@ -0,0 +1,327 @@
+/* Author: Seth George */
+
+#include "aiffutil.h"
+#include "cs229util.h"
+#include <time.h>
+
+#define REPEATS 3 /* each case is run this many times, the fastest is reported */
+
+FILE *cs229Text; /* generated CS229 file that the parsing cases read */
+soundfile_t sound; /* generated sample data that the writing cases write */
+unsigned char *bigEndian; /* sound's sample data as it is in an AIFF file, for the decoding cases */
+
+/**
+*	Seconds on the monotonic clock
+*/
+double now(){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+*	Deterministic sample values, a sine-ish sweep with some noise so every digit count shows up
+*/
+int benchSample(int i, int bitDepth){
+	static unsigned int seed = 12345;
+	seed = seed * 1103515245 + 12345;
+	int max = (1 << (bitDepth - 1)) - 1;
+	int value = (i % 200) - 100;
+	value = value * (max / 100) + (int)((seed >> 16) % 64) - 32;
+	if(value > max){
+		value = max;
+	} else if(value < -max){
+		value = -max;
+	}
+	return value;
+}
+
+/**
+*	Fills snd with megabytes worth of generated frames at the given bit depth and channels
+*/
+void benchSoundfile(soundfile_t *snd, int megabytes, int bitDepth, int channels){
+	initSoundfile(snd);
+	strcpy(snd->name, "(bench)");
+	strcpy(snd->format, "CS229");
+	snd->sampleRate = 44100;
+	snd->bitDepth = bitDepth;
+	snd->channels = channels;
+	snd->samples = (megabytes * 1024 * 1024) / (channels * bitDepth/8);
+	snd->numBytes = snd->samples * channels * bitDepth/8;
+	snd->sampleData = malloc(snd->samples * channels * sampleWidth(bitDepth));
+	
+	int i;
+	for(i = 0; i < snd->samples * channels; i++){
+		setSample(snd, i, benchSample(i, bitDepth));
+	}
+}
+
+/**
+*	Writes a generated CS229 file to a temporary file, left at the start
+*/
+FILE *benchCs229File(int megabytes, int bitDepth, int channels){
+	soundfile_t snd;
+	benchSoundfile(&snd, megabytes, bitDepth, channels);
+	FILE *file = tmpfile();
+	writeCs229(&snd, file);
+	free(snd.sampleData);
+	rewind(file);
+	return file;
+}
+
+/**
+*	Time parseCs229 on the text of a generated file
+*/
+double benchCs229Parse(long *bytes){
+	FILE *file = cs229Text;
+	soundfile_t snd;
+	initSoundfile(&snd);
+	rewind(file);
+	snd.stream = file;
+	
+	double start = now();
+	setFormat(&snd);
+	parseCs229(&snd);
+	double secs = now() - start;
+	
+	*bytes = ftell(file);
+	free(snd.sampleData);
+	return secs;
+}
+
+/**
+*	Time the fscanf("%d") loop that parseData used before its tokenizer, for reference
+*/
+double benchFscanf(long *bytes){
+	FILE *file = cs229Text;
+	soundfile_t snd;
+	initSoundfile(&snd);
+	rewind(file);
+	snd.stream = file;
+	
+	double start = now();
+	setFormat(&snd);
+	parseHeader(&snd);
+	int value;
+	long sum = 0;
+	while(fscanf(file, "%d", &value) == 1){
+		sum += value;
+	}
+	double secs = now() - start;
+	
+	*bytes = ftell(file);
+	return secs + (sum == 1 ? 1e-9 : 0); /* keep the loop from being thrown away */
+}
+
+/**
+*	Time writeCs229 of the generated sample data, into a temporary file
+*/
+double benchCs229Write(long *bytes){
+	FILE *to = tmpfile();
+	double start = now();
+	writeCs229(&sound, to);
+	fflush(to);
+	double secs = now() - start;
+	
+	*bytes = ftell(to);
+	fclose(to);
+	return secs;
+}
+
+/**
+*	Time the fprintf("%d\t") loop that writeCs229 used before its formatter, for reference
+*/
+double benchFprintf(long *bytes){
+	FILE *to = tmpfile();
+	int i;
+	int j;
+	double start = now();
+	writeCs229Header(&sound, to);
+	for(i = 0; i < sound.samples; i++){
+		for(j = 0; j < sound.channels; j++){
+			fprintf(to, "%d\t", getSample(&sound, i*sound.channels + j));
+		}
+		fprintf(to, "\n");
+	}
+	fflush(to);
+	double secs = now() - start;
+	
+	*bytes = ftell(to);
+	fclose(to);
+	return secs;
+}
+
+/**
+*	Time writeAiff of the generated sample data into a temporary file
+*/
+double benchAiffWrite(long *bytes){
+	FILE *to = tmpfile();
+	double start = now();
+	writeAiff(&sound, to);
+	fflush(to);
+	double secs = now() - start;
+	
+	*bytes = ftell(to);
+	fclose(to);
+	return secs;
+}
+
+/**
+*	Time the intToBytes loop that writeAiff used before it encoded blocks, for reference
+*/
+double benchFputc(long *bytes){
+	FILE *to = tmpfile();
+	int i;
+	double start = now();
+	writeAiffHeader(&sound, to);
+	for(i = 0; i < sound.samples * sound.channels; i++){
+		intToBytes(to, getSample(&sound, i), sound.bitDepth/8);
+	}
+	fflush(to);
+	double secs = now() - start;
+	
+	*bytes = ftell(to);
+	fclose(to);
+	return secs;
+}
+
+/**
+*	Time decodeSamples on the big-endian 16 bit sample data
+*/
+double benchDecode16(long *bytes){
+	int count = sound.samples * sound.channels;
+	int16_t *to = malloc(count * sizeof(int16_t));
+	double start = now();
+	decodeSamples(bigEndian, to, count, 16);
+	double secs = now() - start;
+	
+	*bytes = count * 2;
+	free(to);
+	return secs;
+}
+
+/**
+*	Time decodeSamples on the same bytes taken as 24 bit sample data
+*/
+double benchDecode24(long *bytes){
+	int count = sound.samples * sound.channels * 2 / 3;
+	int32_t *to = malloc(count * sizeof(int32_t));
+	double start = now();
+	decodeSamples(bigEndian, to, count, 24);
+	double secs = now() - start;
+	
+	*bytes = count * 3;
+	free(to);
+	return secs;
+}
+
+/**
+*	Time the flipEndianness and power() loop that checkSamples used before decodeSamples, for reference
+*/
+double benchFlip(long *bytes){
+	int count = sound.samples * sound.channels;
+	int16_t *to = malloc(count * sizeof(int16_t));
+	char sample[2];
+	int i;
+	double start = now();
+	for(i = 0; i < count; i++){
+		sample[0] = bigEndian[i*2];
+		sample[1] = bigEndian[i*2 + 1];
+		int value = flipEndianness(sample, 2);
+		if(value >> 15){
+			value = ((value-1)^(power(2, 16)-1));
+			value *= -1;
+		}
+		checkBitDepth(value, 16);
+		to[i] = value;
+	}
+	double secs = now() - start;
+	
+	*bytes = count * 2;
+	free(to);
+	return secs;
+}
+
+/**
+*	Runs a case REPEATS times and prints the fastest in MB/s
+*/
+void runCase(char *name, double (*bench)(long *)){
+	double best = 0;
+	long bytes = 0;
+	int i;
+	for(i = 0; i < REPEATS; i++){
+		double secs = bench(&bytes);
+		if(i == 0 || secs < best){
+			best = secs;
+		}
+	}
+	printf("%-16s %12ld bytes %10.4f s %10.1f MB/s\n", name, bytes, best, bytes / best / (1024 * 1024));
+}
+
+/**
+*	Micro benchmarks for the sample parsers and writers, reported in MB/s.
+*	Only the cases named as arguments are run, or all of them if none are given
+*/
+int main(int argc, char *argv[]){
+	int megabytes = 4; /* size of the generated sample data */
+	int i;
+	int first = 1;
+	
+	for(i = 1; i < argc; i++){
+		if(strcmp(argv[i], "-h") == 0){
+			fprintf(stderr, "\nsndbench times the sample parsers and writers on generated data and prints the throughput in MB/s.\n");
+			fprintf(stderr, "Arguments may be passed as:\n");
+			fprintf(stderr, "\t$ sndbench [-s megabytes] [case] [case] ...\n");
+			fprintf(stderr, "\t-s n: Generate n megabytes of sample data, the default is 4\n");
+			fprintf(stderr, "The cases are: cs229-parse cs229-fscanf cs229-write cs229-fprintf aiff-write aiff-fputc\n");
+			fprintf(stderr, "\taiff-decode16 aiff-decode24 aiff-flip\n");
+			return 0;
+		} else if(strcmp(argv[i], "-s") == 0 && i + 1 < argc){
+			megabytes = atoi(argv[++i]);
+			if(megabytes <= 0){
+				fprintf(stderr, "Error: size must be a positive number of megabytes\n");
+				exit(EXIT_FAILURE);
+			}
+			first = i + 1;
+		} else {
+			break;
+		}
+	}
+	
+	cs229Text = benchCs229File(megabytes, 16, 2);
+	benchSoundfile(&sound, megabytes, 16, 2);
+	bigEndian = malloc(sound.samples * sound.channels * 2);
+	swapBytes16(sound.sampleData, bigEndian, sound.samples * sound.channels);
+	
+	struct { char *name; double (*bench)(long *); } cases[] = {
+		{"cs229-parse", benchCs229Parse},
+		{"cs229-fscanf", benchFscanf},
+		{"cs229-write", benchCs229Write},
+		{"cs229-fprintf", benchFprintf},
+		{"aiff-write", benchAiffWrite},
+		{"aiff-fputc", benchFputc},
+		{"aiff-decode16", benchDecode16},
+		{"aiff-decode24", benchDecode24},
+		{"aiff-flip", benchFlip},
+	};
+	int numCases = sizeof(cases) / sizeof(cases[0]);
+	printf("decode kernels: %s\n", decodeKernel());
+	
+	int j;
+	for(j = 0; j < numCases; j++){
+		int run = (first >= argc);
+		for(i = first; i < argc; i++){
+			if(strcmp(argv[i], cases[j].name) == 0){
+				run = 1;
+			}
+		}
+		if(run){
+			runCase(cases[j].name, cases[j].bench);
+		}
+	}
+	
+	fclose(cs229Text);
+	free(sound.sampleData);
+	free(bigEndian);
+	return 0;
+}
@@ -0,0 +1,151 @@
+/* Author: Seth George */
+
+#define _GNU_SOURCE /* for struct ucred */
+#include "daemonutil.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/**
+*	Returns 1 if name is one of the programs sndd can stand in for
+*/
+int isCommand(char *name){
+	return strcmp(name, "sndinfo") == 0 || strcmp(name, "sndconv") == 0 || strcmp(name, "sndcut") == 0 || strcmp(name, "sndcat") == 0
+		|| strcmp(name, "info") == 0 || strcmp(name, "conv") == 0 || strcmp(name, "cut") == 0 || strcmp(name, "cat") == 0;
+}
+
+/**
+*	Connects to the daemon listening at path, exiting if none is, or if it is not run by this user
+*/
+int connectDaemon(char *path){
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if(strlen(path) >= sizeof(address.sun_path)){
+		fprintf(stderr, "Error: socket path %s is too long\n", path);
+		exit(EXIT_FAILURE);
+	}
+	strcpy(address.sun_path, path);
+	
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(fd < 0 || connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0){
+		fprintf(stderr, "Error: could not connect to sndd on %s: %s\n", path, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	if(!peerIsUser(fd)){ /* the working directory and streams are only passed to this user's own daemon */
+		fprintf(stderr, "Error: the socket %s is not served by this user's sndd\n", path);
+		exit(EXIT_FAILURE);
+	}
+	return fd;
+}
+
+/**
+*	Sends the command and its arguments, with the working directory and the three standard streams,
+*	so the daemon opens the files named and reads and writes the streams as the program itself would
+*/
+void sendRequest(int fd, int argc, char *argv[]){
+	static char request[sizeof(requestheader_t) + MAX_REQUEST_LENGTH]; /* the header, then the arguments */
+	requestheader_t header;
+	header.magic = REQUEST_MAGIC;
+	header.argc = argc;
+	header.length = 0;
+	int i;
+	for(i = 0; i < argc; i++){
+		int length = strlen(argv[i]) + 1;
+		if(argc > MAX_REQUEST_ARGS || header.length + length > MAX_REQUEST_LENGTH){
+			fprintf(stderr, "Error: too many arguments for sndd\n");
+			exit(EXIT_FAILURE);
+		}
+		memcpy(request + sizeof(header) + header.length, argv[i], length);
+		header.length += length;
+	}
+	memcpy(request, &header, sizeof(header));
+	
+	int fds[REQUEST_FDS] = { open(".", O_RDONLY | O_DIRECTORY), STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO };
+	if(fds[0] < 0){
+		fprintf(stderr, "Error: could not open the working directory: %s\n", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	char control[CMSG_SPACE(sizeof(fds))];
+	memset(control, 0, sizeof(control));
+	struct iovec part = { request, sizeof(header) + header.length };
+	struct msghdr message;
+	memset(&message, 0, sizeof(message));
+	message.msg_iov = &part;
+	message.msg_iovlen = 1;
+	message.msg_control = control;
+	message.msg_controllen = sizeof(control);
+	struct cmsghdr *passed = CMSG_FIRSTHDR(&message);
+	passed->cmsg_level = SOL_SOCKET;
+	passed->cmsg_type = SCM_RIGHTS;
+	passed->cmsg_len = CMSG_LEN(sizeof(fds));
+	memcpy(CMSG_DATA(passed), fds, sizeof(fds));
+	
+	ssize_t sent = sendmsg(fd, &message, MSG_NOSIGNAL);
+	size_t done = (sent > 0) ? sent : 0;
+	while(sent > 0 && done < part.iov_len){ /* the descriptors went with the first part, the rest is sent plainly */
+		sent = send(fd, request + done, part.iov_len - done, MSG_NOSIGNAL);
+		done += (sent > 0) ? sent : 0;
+	}
+	if(sent <= 0){
+		fprintf(stderr, "Error: could not send the request to sndd: %s\n", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	close(fds[0]);
+}
+
+/**
+*	A client for sndd, which stands in for sndinfo, sndconv, sndcut and sndcat without starting them.
+*	Run as $ sndc [-s socket] command [arguments], or through a link named after the program
+*/
+int main(int argc, char *argv[]){
+	char *path = getenv("SNDD_SOCKET");
+	char defaultPath[MAX_SOCKET_PATH];
+	char *name = strrchr(argv[0], '/');
+	name = name ? name + 1 : argv[0];
+	int first = 0; /* the command, then its arguments */
+	if(!isCommand(name)){ /* run as sndc, the command comes after its own switches */
+		for(first = 1; first < argc && argv[first][0] == '-'; first++){
+			if(strcmp(argv[first], "-h") == 0){
+				fprintf(stderr, "\nsndc runs sndinfo, sndconv, sndcut and sndcat in a running sndd, rather than starting them.\n");
+				fprintf(stderr, "The files named are opened by sndd from the current directory, and it reads and writes\n");
+				fprintf(stderr, "the standard streams of sndc. The exit status is the one the program would have exited with.\n");
+				fprintf(stderr, "Arguments may be passed as:\n");
+				fprintf(stderr, "\t$ sndc [-s socket] command [arguments]\n");
+				fprintf(stderr, "where command is sndinfo, sndconv, sndcut or sndcat, or info, conv, cut or cat.\n");
+				fprintf(stderr, "A link to sndc named after one of the programs runs it with the arguments given.\n");
+				fprintf(stderr, "\t-h: Displays a short help screen to standard error, and terminates cleanly\n");
+				fprintf(stderr, "\t-s socket: The socket sndd listens on, otherwise SNDD_SOCKET, or %s in XDG_RUNTIME_DIR\n", SOCKET_NAME);
+				fprintf(stderr, "\t\tor else in %s for the user id\n", SOCKET_DIRECTORY);
+				return 0;
+			} else if(strcmp(argv[first], "-s") == 0 && first + 1 < argc){
+				path = argv[++first];
+			} else {
+				fprintf(stderr, "Error: invalid argument %s\n", argv[first]);
+				exit(EXIT_FAILURE);
+			}
+		}
+		if(first >= argc || !isCommand(argv[first])){
+			fprintf(stderr, "Error: expected sndinfo, sndconv, sndcut or sndcat as the command\n");
+			exit(EXIT_FAILURE);
+		}
+	} else {
+		argv[0] = name;
+	}
+	
+	if(!path){
+		defaultSocket(defaultPath, 0);
+		path = defaultPath;
+	}
+	int fd = connectDaemon(path);
+	sendRequest(fd, argc - first, argv + first);
+	int status;
+	if(recv(fd, &status, sizeof(status), MSG_WAITALL) != sizeof(status)){
+		fprintf(stderr, "Error: sndd closed the connection before the command finished\n");
+		exit(EXIT_FAILURE);
+	}
+	close(fd);
+	return status;
+}
@@ -2,6 +2,7 @@
 
 #include "aiffutil.h"
 #include "cs229util.h"
+#include "catutil.h"
 
 /**
 *	Reads all sound files passed as arguments,
@@ -9,13 +10,17 @@
 *	is the concatenation of the sample data in the inputs
 */
 int main(int argc, char *argv[]){
+	argc = statsSwitch(argc, argv);
 	soundfile_t combined;
-	int isFirst = 1;
+	int numFiles = 0;
+	char *names[argc]; /* the files, in order */
+	int numThreads = 1; /* files decoded at the same time */
 	
 	int forceAIFF = 0; /* flag for force aiff */
 	int forceCS229 = 0; /* flag for force cs229 */	
 	int i;
-	for(i = 1; i < argc; i++){ /* check for switches */
+	statsPhase("probe");
+	for(i = 1; i < argc; i++){ /* check for switches, and probe every file so the output header can be written first */
 		if(strcmp(argv[i], "-h") == 0){ /* if the arg is -h, display help screen */
 			fprintf(stderr, "\nsndcat reads all sound files passed as arguments, and writes a single sound file\n");
 			fprintf(stderr, "where the sample data is the concatenation of the sample data in the inputs.\n");
@@ -26,6 +31,8 @@ int main(int argc, char *argv[]){
 			fprintf(stderr, "\t-h: Displays a short help screen to standard error, and then terminate cleanly.\n");
 			fprintf(stderr, "\t-a: Force output to be AIFF\n");
 			fprintf(stderr, "\t-c: Force output to be CS229\n");
+			fprintf(stderr, "\t-j n: Decode up to n files at the same time, the output is still in the order given\n");
+			fprintf(stderr, "\t--stats: Print the time of each phase, the bytes and frames read and the memory used to standard error\n");
 			return 0;
 			
 		} else if ((strcmp(argv[i], "-a") == 0)){ /* force output to be AIFF */
@@ -34,6 +41,12 @@ int main(int argc, char *argv[]){
 		} else if ((strcmp(argv[i], "-c") == 0)){ /* force output to be AIFF */
 			forceCS229 = 1;
 			forceAIFF = 0;			
+		} else if(strcmp(argv[i], "-j") == 0){ /* number of decoding threads */
+			if(i + 1 >= argc || (numThreads = atoi(argv[i + 1])) < 1){
+				fprintf(stderr, "Error: -j must be followed by a number of threads of at least 1\n");
+				exit(EXIT_FAILURE);
+			}
+			i++;
 		} else { /* take in a file name as an argument */	
 			soundfile_t snd;
 			initSoundfile(&snd);
@@ -47,57 +60,84 @@ int main(int argc, char *argv[]){
 			setFormat(&snd); /* should throw error if not CS229 or AIFF */
 			
 			if(strcmp(snd.format, "CS229") == 0){
-				parseCs229(&snd);
+				probeCs229(&snd);
+			} else if(strcmp(snd.format, "CS229B") == 0){
+				probeCs229b(&snd);
 			} else {
-				parseAiff(&snd);
+				probeAiff(&snd);
 			}
 			fclose(snd.stream);
 			
-			if(isFirst){ /* if is the first sndfile given */
+			if(numFiles == 0){ /* if is the first sndfile given */
 				combined = snd;
-				isFirst = 0;
 			} else {
 				if((combined.sampleRate != snd.sampleRate) || (combined.bitDepth != snd.bitDepth) || (combined.channels != snd.channels)){
 					fprintf(stderr, "Error: input argument sample rate, bit depth, or channels did not match of first file");//TODO
 					exit(EXIT_FAILURE);
 				}
-				
-				/* add samples of this file to be combined */
-				int oldSize = combined.samples * combined.channels; 
-				combined.samples += snd.samples;
-				int newSize = combined.samples * combined.channels;
-				combined.sampleData = realloc(combined.sampleData, newSize * sizeof(int));
-			
-				if(!combined.sampleData) { /* if statement to check that memory could be reallocated */
-					fprintf(stderr, "Error: was unable to allocate memory");
-					exit(EXIT_FAILURE);
-				}
-				int j;
-				for(j = oldSize; j < newSize; j++) {
-					combined.sampleData[j] = snd.sampleData[j - oldSize];
-				}
+				combined.samples += snd.samples; /* only the count is added, the samples are streamed below */
 			}
+			names[numFiles++] = argv[i];
 		}
 	}
 	
-	if(argc == 1){ /* if no files were specified */
+	if(numFiles == 0){ /* if no files were specified */
+		statsPhase("parse");
 		initSoundfile(&combined);
 		combined.stream = stdin; /* read from standard input */
 		
 		setFormat(&combined);
 		if(strcmp(combined.format, "CS229") == 0){
 			parseCs229(&combined);
+		} else if(strcmp(combined.format, "CS229B") == 0){
+			parseCs229b(&combined);
 		} else {
 			parseAiff(&combined);
 		}
 		fclose(combined.stream);
 	}
 	
+	statsFrames(combined.samples);
+	
 	/* write the new sndcat'd file */
 	if(!forceCS229 && ((strcmp(combined.format, "AIFF") == 0) || forceAIFF)){
-		writeAiff(&combined, stdout);
+		strcpy(combined.format, "AIFF");
 	} else {
-		writeCs229(&combined, stdout);
+		strcpy(combined.format, "CS229");
+	}
+	
+	statsPhase(numFiles == 0 ? "write" : "stream");
+	if(numFiles == 0){
+		if(strcmp(combined.format, "AIFF") == 0){
+			writeAiff(&combined, stdout);
+		} else {
+			writeCs229(&combined, stdout);
+		}
+		return 0;
+	}
+	
+	if(strcmp(combined.format, "AIFF") == 0){
+		writeAiffHeader(&combined, stdout);
+	} else {
+		writeCs229Header(&combined, stdout);
+	}
+	
+	if(numThreads > 1){
+		catParallel(names, numFiles, numThreads, &combined, stdout);
+		return 0;
+	}
+	
+	for(i = 0; i < numFiles; i++){ /* stream the samples of each file after the header, in order */
+		soundfile_t snd;
+		initSoundfile(&snd);
+		snd.stream = fopen(names[i], "r");
+		if(!snd.stream){ /* it could be opened when probed */
+			fprintf(stderr, "Error: invalid file argument, cannot be opened.\n");
+			exit(EXIT_FAILURE);
+		}
+		setFormat(&snd);
+		streamSamples(&snd, &combined, stdout);
+		fclose(snd.stream);
 	}
 	
 	return 0;
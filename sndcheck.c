@@ -0,0 +1,267 @@
+/* Author: Seth George */
+
+#include "libsnd.h"
+#include "editutil.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define CHECK_BUFFER 4096 /* room for the small files the cases write */
+
+sndhandle_t *handle; /* reused for every case */
+
+/**
+*	Reads the sound in the size bytes at data into the handle, returning the code of sndRead
+*/
+int readBytes(const void *data, size_t size){
+	FILE *stream = fmemopen((void *)data, size, "r");
+	int code = sndRead(handle, stream, "(check)");
+	fclose(stream);
+	return code;
+}
+
+/**
+*	Writes the sound in the handle as format into out, and returns the number of bytes written
+*/
+long writeBytes(const char *format, unsigned char *out){
+	FILE *stream = fmemopen(out, CHECK_BUFFER, "w");
+	if(sndWrite(handle, stream, format) != SND_OK){
+		fclose(stream);
+		return -1;
+	}
+	long size = ftell(stream);
+	fclose(stream);
+	return size;
+}
+
+/**
+*	A 12 bit CS229 file written as AIFF keeps each sample in bitDepth/8 bytes, the low byte, as it always was
+*/
+int check12BitWrite(){
+	const char *text = "CS229\nSampleRate 8000\nSamples 2\nBitDepth 12\nChannels 1\nStartData\n1\n2\n";
+	unsigned char out[CHECK_BUFFER];
+	if(readBytes(text, strlen(text)) != SND_OK){
+		return 0;
+	}
+	long size = writeBytes("AIFF", out);
+	return size > 2 && out[size - 2] == 1 && out[size - 1] == 2;
+}
+
+/**
+*	The same 12 bit file read back from AIFF decodes to the samples it was written from
+*/
+int check12BitRead(){
+	const char *text = "CS229\nSampleRate 8000\nSamples 2\nBitDepth 12\nChannels 1\nStartData\n1\n2\n";
+	unsigned char aiff[CHECK_BUFFER];
+	int first;
+	int second;
+	if(readBytes(text, strlen(text)) != SND_OK){
+		return 0;
+	}
+	long size = writeBytes("AIFF", aiff);
+	if(size < 0 || readBytes(aiff, size) != SND_OK){
+		return 0;
+	}
+	return sndGetSample(handle, 0, 0, &first) == SND_OK && sndGetSample(handle, 1, 0, &second) == SND_OK
+		&& first == 1 && second == 2;
+}
+
+/**
+*	A 32 bit CS229 sample past the range of an int is rejected, not read as the largest int
+*/
+int check32BitOverflow(){
+	const char *text = "CS229\nSampleRate 8000\nSamples 1\nBitDepth 32\nChannels 1\nStartData\n2147483648\n";
+	return readBytes(text, strlen(text)) == SND_ERR_DATA;
+}
+
+/**
+*	A CS229B header whose samples would not fit in an int of bytes is rejected before anything is allocated for them
+*/
+int checkCs229bOversized(){
+	const char *text = "CS229B\nSampleRate 8000\nSamples 1073741825\nBitDepth 16\nChannels 2\nCoding varint\n#\nStartData\n\x02\x02";
+	return readBytes(text, strlen(text)) == SND_ERR_FORMAT;
+}
+
+/**
+*	Stereo 16 bit samples for the CS229B cases, with negative ones and steps too big for one varint byte
+*/
+const char *cs229bText = "CS229\nSampleRate 8000\nSamples 4\nBitDepth 16\nChannels 2\nStartData\n1 -1\n300 -300\n-32768 32767\n0 5\n";
+const int cs229bSamples[] = {1, -1, 300, -300, -32768, 32767, 0, 5};
+
+/**
+*	Returns 1 if the sound in the handle is numFrames stereo frames of the given values
+*/
+int hasSamples(const int values[], int numFrames){
+	sndinfo_t info;
+	int value;
+	int i;
+	if(sndGetInfo(handle, &info) != SND_OK || info.samples != numFrames){
+		return 0;
+	}
+	for(i = 0; i < numFrames * 2; i++){
+		if(sndGetSample(handle, i / 2, i % 2, &value) != SND_OK || value != values[i]){
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/**
+*	Writes the sound in the handle as raw CS229B to a temporary file, left at its start so reading it maps it
+*/
+FILE *writeRawTemp(){
+	FILE *stream = tmpfile();
+	if(!stream){
+		return NULL;
+	}
+	if(sndSetCoding(handle, SND_CODING_RAW) != SND_OK || sndWrite(handle, stream, "CS229B") != SND_OK){
+		fclose(stream);
+		return NULL;
+	}
+	rewind(stream);
+	return stream;
+}
+
+/**
+*	A CS229 file written as CS229B in each coding and read back is written as CS229 exactly as it was
+*/
+int checkCs229bRoundTrip(){
+	unsigned char original[CHECK_BUFFER];
+	unsigned char binary[CHECK_BUFFER];
+	unsigned char text[CHECK_BUFFER];
+	int coding;
+	if(readBytes(cs229bText, strlen(cs229bText)) != SND_OK){
+		return 0;
+	}
+	long size = writeBytes("CS229", original);
+	for(coding = SND_CODING_RAW; coding <= SND_CODING_DELTA; coding++){
+		if(readBytes(cs229bText, strlen(cs229bText)) != SND_OK || sndSetCoding(handle, coding) != SND_OK){
+			return 0;
+		}
+		long binarySize = writeBytes("CS229B", binary);
+		if(binarySize < 0 || readBytes(binary, binarySize) != SND_OK || !hasSamples(cs229bSamples, 4)){
+			return 0;
+		}
+		if(writeBytes("CS229", text) != size || memcmp(text, original, size) != 0){
+			return 0;
+		}
+	}
+	return size > 0;
+}
+
+/**
+*	Cutting a raw CS229B file, whose samples are used in place in its mapping, keeps the frames around the cut
+*/
+int checkCs229bMappedCut(){
+	const int kept[] = {1, -1, 0, 5};
+	int low[] = {1};
+	int high[] = {2};
+	if(readBytes(cs229bText, strlen(cs229bText)) != SND_OK){
+		return 0;
+	}
+	FILE *stream = writeRawTemp();
+	if(!stream){
+		return 0;
+	}
+	int passed = sndRead(handle, stream, "(check)") == SND_OK && sndCut(handle, low, high, 1) == SND_OK;
+	fclose(stream);
+	return passed && hasSamples(kept, 2) && sndClear(handle) == SND_OK;
+}
+
+/**
+*	sndedit's loader shows a mapped raw CS229B file and lets go of the mapping when it is freed
+*/
+int checkCs229bLoader(){
+	soundfile_t snd;
+	loader_t loader;
+	int passed = 1;
+	int i;
+	if(readBytes(cs229bText, strlen(cs229bText)) != SND_OK){
+		return 0;
+	}
+	initSoundfile(&snd);
+	snd.stream = writeRawTemp();
+	if(!snd.stream){
+		return 0;
+	}
+	strcpy(snd.name, "(check)");
+	setFormat(&snd);
+	startLoader(&loader, &snd, BLOCK_FRAMES);
+	for(i = 0; i < 8; i++){
+		passed = passed && loadSample(&loader, 0, i) == cs229bSamples[i];
+	}
+	passed = passed && loader.snd.mapped != NULL;
+	freeLoader(&loader);
+	return passed;
+}
+
+/**
+*	Counts the blocks an allocator has handed out and not had back
+*/
+void *countedMalloc(size_t size, void *arg){
+	(*(long *)arg)++;
+	return malloc(size);
+}
+
+void countedFree(void *data, void *arg){
+	(*(long *)arg)--;
+	free(data);
+}
+
+/**
+*	Everything a handle's allocator hands out, for good files and ones that fail part way, is back once it is closed
+*/
+int checkAllocator(){
+	const char *good = "CS229\nSampleRate 8000\nSamples 2\nBitDepth 12\nChannels 1\nStartData\n1\n2\n";
+	const char *bad = "CS229\nSampleRate 8000\nSamples 3\nBitDepth 8\nChannels 1\nStartData\n1\n2\n999\n";
+	long outstanding = 0;
+	sndallocator_t allocator = { countedMalloc, NULL, countedFree, &outstanding };
+	sndhandle_t *counted = sndOpen(&allocator);
+	sndhandle_t *saved = handle;
+	handle = counted;
+	int passed = readBytes(good, strlen(good)) == SND_OK && readBytes(bad, strlen(bad)) == SND_ERR_DATA
+		&& readBytes(good, strlen(good)) == SND_OK;
+	handle = saved;
+	sndClose(counted);
+	return passed && outstanding == 0;
+}
+
+/**
+*	Runs a case and prints whether it passed, returning 1 if it failed
+*/
+int runCheck(char *name, int (*check)()){
+	int passed = check();
+	printf("%s %s\n", passed ? "ok  " : "FAIL", name);
+	return !passed;
+}
+
+/**
+*	Regression checks for files the sample audio does not cover, run by $ make check.
+*	Exits with a failure if any of them fail
+*/
+int main(int argc, char *argv[]){
+	handle = sndOpen(NULL);
+	if(!handle){
+		fprintf(stderr, "Error: could not open a handle\n");
+		exit(EXIT_FAILURE);
+	}
+	
+	struct { char *name; int (*check)(); } cases[] = {
+		{"aiff-write-12bit", check12BitWrite},
+		{"aiff-read-12bit", check12BitRead},
+		{"cs229-read-32bit-overflow", check32BitOverflow},
+		{"cs229b-read-oversized", checkCs229bOversized},
+		{"cs229b-round-trip", checkCs229bRoundTrip},
+		{"cs229b-cut-mapped", checkCs229bMappedCut},
+		{"cs229b-loader", checkCs229bLoader},
+		{"handle-allocator", checkAllocator},
+	};
+	int numCases = sizeof(cases) / sizeof(cases[0]);
+	int failed = 0;
+	int i;
+	for(i = 0; i < numCases; i++){
+		failed += runCheck(cases[i].name, cases[i].check);
+	}
+	
+	sndClose(handle);
+	return failed ? EXIT_FAILURE : 0;
+}
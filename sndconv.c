@@ -2,16 +2,24 @@
 
 #include "aiffutil.h"
 #include "cs229util.h"
+#include "convutil.h"
+#include <unistd.h>
 
 /**
- This program converts from CS229 file format AIFF, and vice versa.
+ This program converts from CS229 file format AIFF, and vice versa, and to and from CS229B.
  The program reads in the name of the input file, and then read in the name of the output file
  The output file should be written in the opposing file format
 */
 int main(int argc, char *argv[]){
 	int forceAIFF = 0; /* flag for force aiff */
 	int forceCS229 = 0; /* flag for force cs229 */
+	int forceCS229B = 0; /* flag for force cs229b */
+	int coding = SND_CODING_RAW; /* of CS229B output */
+	char *src = NULL; /* directories given with -r */
+	char *dst = NULL;
+	int numThreads = sysconf(_SC_NPROCESSORS_ONLN); /* -r converts on a thread per core */
 	int i;
+	argc = statsSwitch(argc, argv);
 	for(i = 1; i < argc; i++){ /* check for switches */
 		if(strcmp(argv[i], "-h") == 0){ /* if the arg is -h, display help screen */
 			fprintf(stderr, "\nsndconv is read from standard input and writes to standard output.\n");
@@ -23,44 +31,89 @@ int main(int argc, char *argv[]){
 			fprintf(stderr, "\t-1: Prompts for a file name rather than accepting it as an argument\n");
 			fprintf(stderr, "\t-a: Force output to be AIFF, regardless of the input format\n");
 			fprintf(stderr, "\t-c: Force output to be CS229, regardless of the input format\n");
+			fprintf(stderr, "\t-b: Force output to be CS229B, the binary CS229, regardless of the input format\n");
+			fprintf(stderr, "\t-e coding: With -b, store the samples raw, varint or delta coded, the default is raw\n");
+			fprintf(stderr, "\t-r src dst: Convert every AIFF and CS229 file under the directory src to the same place under dst,\n");
+			fprintf(stderr, "\t\t on a thread per core, and print the totals to standard error. Each file is read whole by one thread,\n");
+			fprintf(stderr, "\t\t and only the encoding of a big file is split between them\n");
+			fprintf(stderr, "\t-j n: With -r, convert on n threads\n");
+			fprintf(stderr, "\t--stats: Print the time of each phase, the bytes and frames read and the memory used to standard error\n");
 			return 0;
-			
+		
 		} else if (strcmp(argv[i], "-1") == 0){ /* if the arg is -1, act as part 1*/
 			basicSndconv();
-			
+		
 		} else if ((strcmp(argv[i], "-a") == 0)){ /* force output to be AIFF */
 			forceAIFF = 1;
 			forceCS229 = 0;
-			
+			forceCS229B = 0;
+		
 		} else if ((strcmp(argv[i], "-c") == 0)){ /* force output to be AIFF */
 			forceCS229 = 1;
 			forceAIFF = 0;
-			
+			forceCS229B = 0;
+		
+		} else if(strcmp(argv[i], "-b") == 0){ /* force output to be CS229B */
+			forceCS229B = 1;
+			forceAIFF = 0;
+			forceCS229 = 0;
+		
+		} else if(strcmp(argv[i], "-e") == 0 && i + 1 < argc){ /* coding of CS229B output */
+			i++;
+			if(strcmp(argv[i], "raw") == 0){
+				coding = SND_CODING_RAW;
+			} else if(strcmp(argv[i], "varint") == 0){
+				coding = SND_CODING_VARINT;
+			} else if(strcmp(argv[i], "delta") == 0){
+				coding = SND_CODING_DELTA;
+			} else {
+				fprintf(stderr, "Error: -e must be followed by raw, varint or delta\n");
+				exit(EXIT_FAILURE);
+			}
+		
+		} else if(strcmp(argv[i], "-r") == 0 && i + 2 < argc){ /* convert a directory */
+			src = argv[++i];
+			dst = argv[++i];
+		
+		} else if(strcmp(argv[i], "-j") == 0){ /* number of converting threads */
+			if(i + 1 >= argc || (numThreads = atoi(argv[i + 1])) < 1){
+				fprintf(stderr, "Error: -j must be followed by a number of threads of at least 1\n");
+				exit(EXIT_FAILURE);
+			}
+			i++;
+		
 		} else {  /*invalid switch */
 			fprintf(stderr, "Error: invalid argument");
 			exit(EXIT_FAILURE);
 		}
 	}
-	soundfile_t from;
-	initSoundfile(&from);
-	
-	strcpy(from.name, "(standard input)"); /* treat standard input as file */
-	from.stream = stdin; /* read from standard input */
+	if(src){
+		statsPhase("convert");
+		return convertTree(src, dst, forceAIFF, forceCS229, forceCS229B, coding, numThreads) ? 0 : EXIT_FAILURE;
+	}
 	
-	setFormat(&from);
-	if(strcmp(from.format, "CS229") == 0){
-		parseCs229(&from);
-	} else {
-		parseAiff(&from);
+	sndhandle_t *handle = sndOpen(NULL);
+	if(!handle){
+		sndExitOnError(handle, SND_ERR_MEMORY);
 	}
-	fclose(from.stream);
+	
+	statsPhase("parse");
+	sndExitOnError(handle, sndRead(handle, stdin, "(standard input)")); /* treat standard input as file */
+	fclose(stdin);
+	soundfile_t *from = handleSound(handle);
+	statsFrames(from->samples);
 	
 	/* write the converted file */
-	if(!forceCS229 && ((strcmp(from.format, "CS229") == 0) || forceAIFF)){
-		writeAiff(&from, stdout);
+	statsPhase("write");
+	if(forceCS229B){
+		sndExitOnError(handle, sndSetCoding(handle, coding));
+		sndExitOnError(handle, sndWrite(handle, stdout, "CS229B"));
+	} else if(!forceCS229 && ((strncmp(from->format, "CS229", 5) == 0) || forceAIFF)){ /* CS229B goes to AIFF like CS229 */
+		sndExitOnError(handle, sndWrite(handle, stdout, "AIFF"));
 	} else {
-		writeCs229(&from, stdout);
+		sndExitOnError(handle, sndWrite(handle, stdout, "CS229"));
 	}
 	
+	sndClose(handle);
 	return 0;
 }
\ No newline at end of file
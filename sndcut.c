@@ -9,6 +9,7 @@
 *	after removing all samples specified as arguments.
 */
 int main(int argc, char *argv[]){
+	argc = statsSwitch(argc, argv);
 	soundfile_t snd;
 	initSoundfile(&snd);
 	int low[argc - 1];
@@ -28,6 +29,7 @@ int main(int argc, char *argv[]){
 			fprintf(stderr, "including the samples at low and high themselves, are to be removed.\n");
 			fprintf(stderr, "This program supports the following switches, passed as arguments.\n");
 			fprintf(stderr, "\t-h: Display a short help screen to standard error, and then terminate cleanly.\n");
+			fprintf(stderr, "\t--stats: Print the time of each phase, the bytes and frames read and the memory used to standard error\n");
 			return 0;
 			
 		} else { /* take in the [low..high] args */
@@ -54,20 +56,51 @@ int main(int argc, char *argv[]){
 		}
 	}
 	
+	int numRanges = mergeRanges(low, high, argc - 1); /* sorted, so each is passed once */
+	
 	snd.stream = stdin; /* read from standard input */
+	statsPhase("header");
 	setFormat(&snd); /* get info from file */
 	if(strcmp(snd.format, "AIFF") == 0){
-		parseAiff(&snd);
+		if(mapAiff(&snd)){ /* kept sample data is copied straight from the mapped file */
+			statsFrames(snd.samples);
+			statsPhase("cut");
+			cutMappedAiff(low, high, numRanges, &snd, stdout);
+			unmapAiff(&snd);
+			return 0;
+		}
+		if(parseAiffChunks(&snd, AIFF_STREAM)){ /* otherwise it is streamed a block at a time */
+			statsFrames(snd.samples);
+			statsPhase("cut");
+			cutAiffStream(low, high, numRanges, &snd, stdout);
+			return 0;
+		}
+	} else if(strcmp(snd.format, "CS229B") == 0){ /* raw samples are mapped and cut in place */
+		statsPhase("parse");
+		parseCs229b(&snd);
 	} else {
-		parseCs229(&snd);
+		parseHeader(&snd);
+		if(snd.samples > 0){ /* the header has to be written before the samples are counted */
+			statsFrames(snd.samples);
+			statsPhase("cut");
+			cutCs229Stream(low, high, numRanges, &snd, stdout);
+			return 0;
+		}
+		statsPhase("parse");
+		parseData(&snd);
 	}
+	statsFrames(snd.samples);
 	
-	dataCut(low, high, argc, &snd);
+	statsPhase("cut");
+	dataCut(low, high, numRanges, &snd);
 	
 	fclose(snd.stream);
 	
+	statsPhase("write");
 	if(strcmp(snd.format, "AIFF") == 0){
 		writeAiff(&snd, stdout);
+	} else if(strcmp(snd.format, "CS229B") == 0){
+		writeCs229b(&snd, stdout);
 	} else {
 		writeCs229(&snd, stdout);
 	}
@@ -0,0 +1,50 @@
+/* Author: Seth George */
+
+#include "daemonutil.h"
+#include <unistd.h>
+
+/**
+*	A daemon that runs sndinfo, sndconv, sndcut and sndcat for sndc on a UNIX socket,
+*	so a caller converting many small files does not start a program for each of them
+*/
+int main(int argc, char *argv[]){
+	char *path = getenv("SNDD_SOCKET");
+	char defaultPath[MAX_SOCKET_PATH];
+	int numThreads = sysconf(_SC_NPROCESSORS_ONLN); /* requests are run on a thread per core */
+	int i;
+	for(i = 1; i < argc; i++){ /* check for switches */
+		if(strcmp(argv[i], "-h") == 0){ /* if the arg is -h, display help screen */
+			fprintf(stderr, "\nsndd listens on a UNIX socket and runs sndinfo, sndconv, sndcut and sndcat for sndc,\n");
+			fprintf(stderr, "on threads that are started once and kept, with their buffers, between requests.\n");
+			fprintf(stderr, "It runs until it is interrupted or terminated, and then removes the socket.\n");
+			fprintf(stderr, "Arguments may be passed as:\n");
+			fprintf(stderr, "\t$ sndd [-s socket] [-j n]\n");
+			fprintf(stderr, "\t-h: Displays a short help screen to standard error, and terminates cleanly\n");
+			fprintf(stderr, "\t-s socket: The socket to listen on, otherwise SNDD_SOCKET, or %s in XDG_RUNTIME_DIR\n", SOCKET_NAME);
+			fprintf(stderr, "\t\tor else in %s for the user id, which is made so only they can use it\n", SOCKET_DIRECTORY);
+			fprintf(stderr, "\t-j n: Run up to n requests at the same time, the default is one per core\n");
+			return 0;
+		
+		} else if(strcmp(argv[i], "-s") == 0 && i + 1 < argc){ /* socket to listen on */
+			path = argv[++i];
+		
+		} else if(strcmp(argv[i], "-j") == 0){ /* number of worker threads */
+			if(i + 1 >= argc || (numThreads = atoi(argv[i + 1])) < 1){
+				fprintf(stderr, "Error: -j must be followed by a number of threads of at least 1\n");
+				exit(EXIT_FAILURE);
+			}
+			i++;
+		
+		} else { /* invalid switch */
+			fprintf(stderr, "Error: invalid argument %s\n", argv[i]);
+			exit(EXIT_FAILURE);
+		}
+	}
+	
+	if(!path){
+		defaultSocket(defaultPath, 1);
+		path = defaultPath;
+	}
+	serveSocket(path, numThreads);
+	return 0;
+}
@@ -2,13 +2,16 @@
 
 #include "aiffutil.h"
 #include "cs229util.h"
+#include "editutil.h"
 #include <ncurses.h>
 
 int main(int argc, char* argv[]) {
 	if(strcmp(argv[1], "-h") == 0){ /* if the arg is -h, display help screen */
 		fprintf(stderr, "\nSndedit is an audio file editor based on the ncurses library.\n");
 		fprintf(stderr, "The executable takes a single argument\n");
-		fprintf(stderr, "where the argument is the pathname of an audio file (either AIFF or CS229 format) to be edited. \n");
+		fprintf(stderr, "where the argument is the pathname of an audio file (AIFF, CS229 or CS229B format) to be edited. \n");
+		fprintf(stderr, "\t$ sndedit [-m megabytes] file\n");
+		fprintf(stderr, "\t-m n: Keep at most n megabytes of decoded samples in memory, the default is %ld\n", CACHE_BUDGET / (1024*1024));
 		fprintf(stderr, "If the audio file cannot be opened, or is not a valid file, or some other error condition occurs,\n");
 		fprintf(stderr, "sndedit should print an appropriate message to standard error, and terminate.\n");
 		fprintf(stderr, "Otherwise, sndedit should display an interactive screen (using ncurses).\n");
@@ -41,29 +44,40 @@ int main(int argc, char* argv[]) {
 		fprintf(stderr, "\t\tright before wherever the cursor is currently positioned.\n");
 		fprintf(stderr, "\t'v' (paste): Just like the other paste keystroke, except\n");
 		fprintf(stderr, "\t\tthe buffer is copied right after wherever the cursor is currently positioned.\n");
+		fprintf(stderr, "\t'u' (undo): If no edits have been made, then this menu item should not be available.\n");
+		fprintf(stderr, "\t\tOtherwise, the last cut or paste that has not been undone is reversed.\n");
+		fprintf(stderr, "\t'r' (redo): If no edits have been undone, then this menu item should not be available.\n");
+		fprintf(stderr, "\t\tOtherwise, the last undone edit is made again. Making a new edit drops the undone edits.\n");
 		fprintf(stderr, "\t's' (save): If the sound data has not been modified, then this menu item should not be available.\n");
 		fprintf(stderr, "\t\tOtherwise, this causes any changes to the sound data to be saved back to the original file.\n");
+		fprintf(stderr, "\t\tThe save runs in the background and replaces the file only once it is completely written.\n");
 		fprintf(stderr, "\t'q' (quit): Revert the screen back to normal, and quit.\n");
 		fprintf(stderr, "Note that the upper right of the display, which shows the information about the sound data,\n");
 		fprintf(stderr, "should be updated whenever the sound data is modified.\n");
 		return 0;
 	}
 	
+	long budget = CACHE_BUDGET; /* bytes of decoded blocks kept at once */
+	int arg = 1;
+	if(strcmp(argv[arg], "-m") == 0 && arg + 1 < argc){
+		budget = (long)parseMegabytes(argv[arg+1]) * 1024 * 1024;
+		arg += 2;
+	}
+	if(arg >= argc){
+		fprintf(stderr, "Error: no file to edit\n");
+		exit(EXIT_FAILURE);
+	}
+	
 	soundfile_t snd;
 	initSoundfile(&snd);
 	
-	snd.stream = fopen(argv[1], "r"); /* argv[1] should be a file name to open */
-	strcpy(snd.name, argv[1]); /* set name to argument */
+	snd.stream = fopen(argv[arg], "r"); /* argv[arg] should be a file name to open */
+	strcpy(snd.name, argv[arg]); /* set name to argument */
 		
 	setFormat(&snd); /* checks if is valid file pointer too*/
 	
-	if(strcmp(snd.format, "CS229") == 0){
-		parseCs229(&snd);
-	} else {
-		parseAiff(&snd);
-	}
-	
-	fclose(snd.stream); /* close file after parsing */
+	loader_t loader; /* only the header is read now, the samples are decoded as they are shown or in the background */
+	startLoader(&loader, &snd, budget);
 	
 	/************************* NCURSES BEGINNING *************************/
 	initscr();
@@ -71,21 +85,33 @@ int main(int argc, char* argv[]) {
 	noecho();
 	keypad(stdscr, TRUE);
 	
-	char *title = calloc((strlen(snd.name)+8), sizeof(char)); /* make the top title string */
+	char *title = calloc((strlen(snd.name)+9), sizeof(char)); /* make the top title string */
 	strcat(title, snd.name); /* because they are all set to null, "end of string" will be title[0] */
 	if(strcmp(snd.format, "CS229") == 0){
 		strcat(title, "(CS229)");
+	} else if(strcmp(snd.format, "CS229B") == 0){
+		strcat(title, "(CS229B)");
 	} else {
 		strcat(title, "(AIFF)");
 	}
 	
-	int button = 0, mark = -1, inBuffer = 0, isModified = 0, reverseVideo = 0, cols = COLS, rows = LINES; /* Flags */
+	int button = 0, mark = -1, inBuffer = 0, isModified = 0, savePending = 0; /* Flags */
 	int x = (COLS-12)/2, y = 2; /* x = middle of sndData, y = top right below title border */
-	int i, j, k;
+	int i;
 	int startSample = 0;
 	int cursorSample = 0;
-	char *sampleIndex = calloc(9, 1); /* first part of the bar is 9 chars long */
-	int *buffer = malloc(1);
+	piecetable_t table; /* the edited sound, as pieces of the sample data that was read */
+	piecetable_t buffer; /* the copied samples, also as pieces of it */
+	initPieces(&table, &snd);
+	initPieces(&buffer, &snd);
+	table.loader = &loader;
+	buffer.loader = &loader;
+	journal_t journal; /* the edits that can be undone and redone */
+	initJournal(&journal);
+	screen_t screen; /* what is on the terminal, so a keystroke only redraws what it changed */
+	initScreen(&screen, title);
+	saver_t saver; /* writes a save in the background */
+	initSaver(&saver);
 	while((button != 'q')&&(button != 'Q')){
 		/************************* SCREEN CHECK *************************/
 		if((COLS < MIN_COLS) || (LINES < MIN_ROWS)){
@@ -93,16 +119,24 @@ int main(int argc, char* argv[]) {
 			exit(EXIT_FAILURE);
 		}
 		
-		if(COLS != cols || LINES != rows){ /* update screen if screen width changes */
-			clear();
-			refresh();
-			cols = COLS;
-			rows = LINES;
+		if(COLS != screen.cols || LINES != screen.lines){ /* update screen if screen width changes */
+			layoutScreen(&screen);
+		}
+		
+		/************************* SAVING *************************/
+		if(endSave(&saver, 0) == -1){
+			isModified = 1; /* the file is as it was, so the edits are still unsaved */
+		}
+		if(savePending && !saver.running){ /* s was pressed during the last save */
+			savePending = 0;
+			if(isModified){
+				startSave(&saver, &table, &snd);
+				isModified = 0;
+			}
 		}
 		
 		/************************* INFO FOR USER *************************/
-		mvprintw(0, (COLS - strlen(title))/2, "%s", title); /* print out title */
-		printSideMenu(&snd, mark, inBuffer, isModified);
+		printSideMenu(&snd, mark, inBuffer, isModified, &journal, &loader, &saver, &screen);
 		
 		/************************* SOUND DATA *************************/
 		int high, low; /* will also be used in copy and cut */
@@ -115,63 +149,20 @@ int main(int argc, char* argv[]) {
 			high = cursorSample;
 		}
 		
-		/* print by a sample at a time */
-		for(i = 0; i < LINES - 2; i+= snd.channels){ /* i/channels is the sample being printed relative to the screen*/
-			if(mark != -1){ /* if the sample is within cursor and mark */
-				if(((startSample + i/snd.channels) >= low) && ((startSample + i/snd.channels) <= high)){
-					attron(A_REVERSE); /* reverse video */
-				} else {
-					attroff(A_REVERSE);/* un-reverse video*/
-				}
-			}
-			
-			if((snd.samples > 0) && ((i/snd.channels + startSample) < snd.samples)){ /* if we should print a sample*/
-				move(2 + i, 0);
-				sprintf(sampleIndex, "%d", startSample + i/snd.channels); 
-				
-				for(j = 0; j < (9 - strlen(sampleIndex)); j ++) { /* the first chars are spaces, then the number */
-					printw(" ");
-				}
-				
-				printw("%s|", sampleIndex); /* the number should be "right justified" */
-				printBarCurses(snd.sampleData[i + startSample*snd.channels], snd.bitDepth);
-				
-				for(j = 1; j < snd.channels; j++){
-					if((2+i+j) < LINES){
-						mvprintw(2+i+j, 0, "         |"); /* for multiple channels, we don't show a number */
-						printBarCurses(snd.sampleData[i + j + startSample*snd.channels] , snd.bitDepth); /* print out the dash bar representation */
-					}
-				}
-			} else { /* if we shouldn't print anything, print blank lines */
-				attroff(A_REVERSE);
-				int printAtY = 2 + i;
-				for(j = 0; j < snd.channels; j++){
-					if(printAtY < LINES) {
-						move(printAtY, 0);
-						for(k = 0; k < COLS-22; k++){
-							addch(' ');
-						}
-						if(COLS%2 == 0){
-							addch(' ');
-						}
-						addch('|');
-					}
-					printAtY++;
-				}
-			}
-		}
-		attroff(A_REVERSE);
+		scrollPane(&screen, startSample, snd.channels); /* a step of one sample scrolls, then one row is drawn */
+		drawPane(&screen, &table, startSample, mark, low, high);
 		
 		/************************* KEYSTROKES *************************/
 		x = (COLS-12)/2;
-		move(y, x); /* move cursor back */
-		button = getch(); /* get next button press */
-		mvprintw(0,0, "heyz2");/////////////////////////////////////////////////
+		wnoutrefresh(stdscr); /* the menu, then the pane over it with the cursor */
+		wmove(screen.pane, y-2, x); /* move cursor back */
+		int loading = loaderProgress(&loader); /* -1 once it failed, then there is nothing more to show */
+		wtimeout(screen.pane, ((loading >= 0 && loading < 100) || saver.running) ? 100 : -1); /* wake up to show the progress */
+		button = wgetch(screen.pane); /* get next button press */
 		if((snd.samples > 0)&& (button == KEY_UP)){ /* arrow up */
 			if(cursorSample > 0){
 				if(y > 2){ /* move cursor up */
 					y -= snd.channels;
-					move(y, x);
 				} else if(startSample > 0){ /* scroll page up */
 					startSample--;
 				}
@@ -181,7 +172,6 @@ int main(int argc, char* argv[]) {
 			if(cursorSample < (snd.samples - 1)){
 				if(y < LINES -1){
 					y += snd.channels;
-					move(y, x);
 				} else if(startSample < (snd.samples - 1)){ /* scroll page down */
 					startSample++;
 				}
@@ -223,6 +213,7 @@ int main(int argc, char* argv[]) {
 			}
 			
 			free(input);
+			forgetLine(&screen, LINES-1); /* the prompt was printed over the last row */
 			y = 2;
 		
 		} else if((snd.samples > 0)&&(button == 'm' || button == 'M')){ /* mark */
@@ -230,39 +221,23 @@ int main(int argc, char* argv[]) {
 				mark = startSample + (y-2)/snd.channels;
 			} else {
 				mark = -1;
-				attroff(A_REVERSE); /* redundant turn off reverse video */
 			}
 			
 		} else if((snd.samples > 0)&&(button == 'c' || button == 'C')){ /* copy */
 			if(mark != -1){				
-				inBuffer = 0;
-				int numSamples = high - low + 1; /* number of samples in buffer */
-				free(buffer);
-				buffer = malloc(numSamples * snd.channels * sizeof(int));
-				for(i = low; i <= high; i++) { /* for each sample */
-					for(j = 0; j < snd.channels; j++){ /* add every channel in the sample */
-						buffer[inBuffer] = snd.sampleData[i*snd.channels + j];
-						inBuffer++;
-					}
-				}
+				copyPieces(&table, low, high, &buffer); /* every channel of each sample */
+				inBuffer = buffer.frames * snd.channels;
 			}
 			
 		} else if((snd.samples > 0)&&(button == 'x' || button == 'X')){ /* cut */
 			if(mark != -1){
 				/* low and high are already declared when checking for reverse video */
-				inBuffer = 0;
-				int numSamples = high - low + 1; /* number of samples in buffer */
-				free(buffer);
-				buffer = malloc(numSamples * snd.channels * sizeof(int));
-				for(i = low; i <= high; i++) { /* for each sample */					
-					for(j = 0; j < snd.channels; j++){ /* add every channel in the sample */
-						buffer[inBuffer] = snd.sampleData[i*snd.channels + j];
-						inBuffer++;
-					}
-				}
-				int lowArr[1] = {low};
-				int highArr[1] = {high};
-				dataCut(lowArr, highArr, 1, &snd);
+				copyPieces(&table, low, high, &buffer); /* every channel of each sample */
+				inBuffer = buffer.frames * snd.channels;
+				recordEdit(&journal, &table, 1, low, high);
+				cutPieces(&table, low, high);
+				snd.samples = table.frames;
+				snd.numBytes = snd.channels*snd.samples*snd.bitDepth/8;
 				if(startSample >= snd.samples){
 					startSample = snd.samples - 1;
 					y = 2;
@@ -273,34 +248,67 @@ int main(int argc, char* argv[]) {
 			
 		} else if((snd.samples > 0)&&(button == '6' || button == '^')){ /* paste above, shift + 6 is ^, so "lowercase" ^ is 6 */
 			if(inBuffer){
-				dataCat(cursorSample, buffer, inBuffer, &snd);
+				pastePieces(&table, cursorSample, &buffer);
+				recordEdit(&journal, &table, 0, cursorSample, cursorSample + buffer.frames - 1);
+				snd.samples = table.frames;
+				snd.numBytes = snd.channels*snd.samples*snd.bitDepth/8;
 				isModified = 1;
 			}
 			
 		} else if((snd.samples > 0)&&(button == 'v' || button == 'V')){ /* paste below */
 			if(inBuffer){
-				dataCat(cursorSample + 1, buffer, inBuffer, &snd);
+				pastePieces(&table, cursorSample + 1, &buffer);
+				recordEdit(&journal, &table, 0, cursorSample + 1, cursorSample + buffer.frames);
+				snd.samples = table.frames;
+				snd.numBytes = snd.channels*snd.samples*snd.bitDepth/8;
 				isModified = 1;
 			}
+		
+		} else if(button == 'u' || button == 'U' || button == 'r' || button == 'R'){ /* undo and redo */
+			int changed;
+			if(button == 'u' || button == 'U'){
+				changed = undoEdit(&journal, &table);
+			} else {
+				changed = redoEdit(&journal, &table);
+			}
 			
-		} else if(button == 's' || button == 'S'){ /* save */
-			if(isModified){
-				FILE *fpout = fopen(snd.name, "w"); /* open for writing */
-				/* write the converted file */
-				if((strcmp(snd.format, "CS229") == 0)){
-					writeCs229(&snd, fpout);
-				} else {
-					writeAiff(&snd, fpout);
+			if(changed){
+				snd.samples = table.frames;
+				snd.numBytes = snd.channels*snd.samples*snd.bitDepth/8;
+				if(startSample >= snd.samples){
+					startSample = (snd.samples > 0) ? snd.samples - 1 : 0;
+					y = 2;
 				}
-				fclose(fpout);
+				mark = -1;
+				isModified = 1;
+			}
+			
+		} else if(button == 's' || button == 'S'){ /* save */
+			if(saver.running){
+				savePending = 1; /* edits made since it started go into the next save */
+			} else if(isModified){
+				startSave(&saver, &table, &snd); /* written on a thread, then renamed over the file */
 				isModified = 0;
 			}
 		}
 	}
 	/* clean up when we're done */
+	int saved = endSave(&saver, 1); /* a save that was started is finished before quitting */
+	if(savePending && isModified && saved != -1){ /* and one that was asked for during it */
+		startSave(&saver, &table, &snd);
+		saved = endSave(&saver, 1);
+	}
 	clrtoeol();
 	refresh();
 	endwin();
+	if(saved == -1){
+		fprintf(stderr, "Error: could not save %s\n", snd.name);
+	}
+	freePieces(&table);
+	freePieces(&buffer);
+	freeJournal(&journal);
+	freeScreen(&screen);
+	freeLoader(&loader);
 	
 	return 0;
 }
\ No newline at end of file
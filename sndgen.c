@@ -0,0 +1,139 @@
+/* Author: Seth George */
+
+#include "aiffutil.h"
+#include "cs229util.h"
+
+/**
+*	Reads the value of a switch, a positive number
+*/
+long parseCount(char *arg, char *name){
+	int j;
+	for(j = 0; j < strlen(arg); j++){
+		if(arg[j] < '0' || arg[j] > '9'){ /* if not a number */
+			fprintf(stderr, "Error: given %s value, %s, is invalid\n", name, arg);
+			exit(EXIT_FAILURE);
+		}
+	}
+	long value = atol(arg);
+	if(strlen(arg) == 0 || value <= 0){
+		fprintf(stderr, "Error: given %s value, %s, is invalid\n", name, arg);
+		exit(EXIT_FAILURE);
+	}
+	return value;
+}
+
+/**
+*	The value of a channel at a frame. A triangle wave with a different period on each channel,
+*	at three quarters of full scale, with noise over it so the values are not all round numbers.
+*	Only depends on its arguments, so the same switches always make the same file
+*/
+int genSample(long frame, int channel, int bitDepth){
+	long long max = (1LL << (bitDepth - 1)) - 1;
+	long period = 100 + channel * 37;
+	long phase = frame % period;
+	long long wave = (phase < period/2) ? phase : period - phase; /* 0 up to period/2 and back */
+	wave = (wave * 4 - period) * (max / 4) / (period / 2) * 3 / 2; /* -3/4 max up to 3/4 max */
+	
+	unsigned int hash = (unsigned int)(frame * 2654435761u) ^ (unsigned int)(channel * 40503u);
+	hash ^= hash >> 15;
+	hash *= 2246822519u;
+	hash ^= hash >> 13;
+	long long noise = (long long)(hash % 1024) - 512;
+	long long value = wave + noise * (max / 4096 + 1);
+	if(value > max){
+		value = max;
+	} else if(value < -max){
+		value = -max;
+	}
+	return (int)value;
+}
+
+/**
+*	Writes a generated sound file to standard output, for benchmarking the other programs
+*	on inputs of any size without keeping them around
+*/
+int main(int argc, char *argv[]){
+	int forceCS229 = 0;
+	int bitDepth = 16;
+	int channels = 2;
+	long frames = 441000; /* ten seconds at 44100 */
+	int i;
+	for(i = 1; i < argc; i++){ /* check for switches */
+		if(strcmp(argv[i], "-h") == 0){ /* if the arg is -h, display help screen */
+			fprintf(stderr, "\nsndgen writes a generated sound file to standard output, for benchmarking.\n");
+			fprintf(stderr, "The samples are a triangle wave with noise over it, and the same switches always give the same file.\n");
+			fprintf(stderr, "Arguments may be passed as:\n");
+			fprintf(stderr, "\t$ sndgen [-a|-c] [-b bits] [-n channels] [-s frames]\n");
+			fprintf(stderr, "\t-a: Write an AIFF file, the default\n");
+			fprintf(stderr, "\t-c: Write a CS229 file\n");
+			fprintf(stderr, "\t-b b: Bit depth of 8, 16, 24 or 32, the default is 16\n");
+			fprintf(stderr, "\t-n n: Number of channels, the default is 2\n");
+			fprintf(stderr, "\t-s s: Number of sample frames, the default is 441000\n");
+			return 0;
+		} else if(strcmp(argv[i], "-a") == 0){
+			forceCS229 = 0;
+		} else if(strcmp(argv[i], "-c") == 0){
+			forceCS229 = 1;
+		} else if(strcmp(argv[i], "-b") == 0 && i + 1 < argc){
+			bitDepth = parseCount(argv[++i], "b");
+			if(bitDepth != 8 && bitDepth != 16 && bitDepth != 24 && bitDepth != 32){
+				fprintf(stderr, "Error: bit depth must be 8, 16, 24 or 32\n");
+				exit(EXIT_FAILURE);
+			}
+		} else if(strcmp(argv[i], "-n") == 0 && i + 1 < argc){
+			channels = parseCount(argv[++i], "n");
+		} else if(strcmp(argv[i], "-s") == 0 && i + 1 < argc){
+			frames = parseCount(argv[++i], "s");
+		} else { /* invalid argument */
+			fprintf(stderr, "Error: invalid argument %s\n", argv[i]);
+			exit(EXIT_FAILURE);
+		}
+	}
+	if(frames * channels * (bitDepth/8) > 0x7FFFFFF0L){ /* AIFF sizes, and the sample counts, are 32 bit */
+		fprintf(stderr, "Error: too many sample frames for a single file\n");
+		exit(EXIT_FAILURE);
+	}
+	
+	soundfile_t snd;
+	initSoundfile(&snd);
+	strcpy(snd.format, forceCS229 ? "CS229" : "AIFF");
+	snd.sampleRate = 44100;
+	snd.bitDepth = bitDepth;
+	snd.channels = channels;
+	snd.samples = frames;
+	setvbuf(stdout, NULL, _IOFBF, WRITE_BLOCK);
+	if(forceCS229){
+		writeCs229Header(&snd, stdout);
+	} else {
+		writeAiffHeader(&snd, stdout);
+	}
+	
+	int width = sampleWidth(bitDepth);
+	void *block = malloc((long)BLOCK_FRAMES * channels * width);
+	long frame;
+	for(frame = 0; frame < frames; frame += BLOCK_FRAMES){ /* a block at a time, so any length fits in memory */
+		int numFrames = (frames - frame < BLOCK_FRAMES) ? frames - frame : BLOCK_FRAMES;
+		int j;
+		int k;
+		for(j = 0; j < numFrames; j++){
+			for(k = 0; k < channels; k++){
+				writeSample(block, width, j*channels + k, genSample(frame + j, k, bitDepth));
+			}
+		}
+		if(forceCS229){
+			writeCs229Frames(&snd, block, numFrames, stdout);
+		} else {
+			writeAiffFrames(&snd, block, numFrames, stdout);
+		}
+	}
+	if(!forceCS229 && (frames * channels * (bitDepth/8)) % 2){
+		fputc(0, stdout); /* the SSND chunk is padded to an even size */
+	}
+	free(block);
+	
+	if(fflush(stdout) != 0 || ferror(stdout)){
+		fprintf(stderr, "Error: could not write the generated file\n");
+		exit(EXIT_FAILURE);
+	}
+	return 0;
+}
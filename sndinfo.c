@@ -3,8 +3,26 @@
 #include "aiffutil.h"
 #include "cs229util.h"
 
+/**
+*	Reads the stats of the file into the handle. Only the header is read unless fullParse is set,
+*	in which case all of the sample data is decoded and checked. Exits if the file is not valid
+*/
+void readInfo(sndhandle_t *handle, FILE *stream, char *name, int fullParse){
+	if(fullParse){
+		sndExitOnError(handle, sndRead(handle, stream, name));
+	} else {
+		sndExitOnError(handle, sndProbe(handle, stream, name));
+	}
+}
+
 int main(int argc, char *argv[]){
+	int fullParse = 0; /* flag for decoding all the sample data */
+	int numFiles = 0;
 	int i;
+	sndhandle_t *handle = sndOpen(NULL); /* reused for every file */
+	if(!handle){
+		sndExitOnError(handle, SND_ERR_MEMORY);
+	}
 	for(i = 1; i < argc; i++){ /* check for switches */
 		if(strcmp(argv[i], "-h") == 0){ /* if the arg is -h, display help screen */
 			fprintf(stderr, "\nsndinfo reads a given file or files and prints a list of stats about the file to stdout.\n");
@@ -17,56 +35,38 @@ int main(int argc, char *argv[]){
 			fprintf(stderr, "\t This program supports the following switches, passed as arguments.\n");
 			fprintf(stderr, "\t-h: Displays a short help screen to standard error, and terminates cleanly\n");
 			fprintf(stderr, "\t-1: Prompt for a file name rather than accepting it as an argument\n");
+			fprintf(stderr, "\t-f: Decode and check all of the sample data, rather than only reading the header\n");
 			return 0;
-			
+		
 		} else if(strcmp(argv[i], "-1") == 0){ /* if the arg is -1, act as part 1*/
 			basicSndinfo();
-			
+		
+		} else if(strcmp(argv[i], "-f") == 0){ /* if the arg is -f, decode the files in full */
+			fullParse = 1;
+		
 		} else { /* you are reading a file name as an argument */
-			soundfile_t snd;
-			initSoundfile(&snd);
-			
-			snd.stream = fopen(argv[i], "r"); /* argv[1] should be a file name to open */
-			strcpy(snd.name, argv[i]); /* set name to argument */
-			
-			if(!snd.stream){ /* invalid file pointer */
+			FILE *stream = fopen(argv[i], "r"); /* argv[1] should be a file name to open */
+			if(!stream){ /* invalid file pointer */
 				fprintf(stderr, "Error: no such file\n");
 				exit(EXIT_FAILURE);
 			}
 			
-			setFormat(&snd);
-			if(strcmp(snd.format, "CS229") == 0){
-				parseCs229(&snd);
-			} else {
-				parseAiff(&snd);
-			}
-			fclose(snd.stream); /* close file after parsing */
+			readInfo(handle, stream, argv[i], fullParse);
+			fclose(stream); /* close file after parsing */
+			numFiles++;
 			
-			snd.duration = ((float)snd.samples)/snd.sampleRate; /* duration in seconds */
-			printSndInfo(&snd);
+			printSndInfo(handleSound(handle));
 		}
 	}
 	
-	if(argc == 1){ /* if no switches or files were given */
-		soundfile_t snd;
-		initSoundfile(&snd);
-		
-		strcpy(snd.name, "(standard input)"); /* read from standard input */
-		snd.stream = stdin;
-		
-		setFormat(&snd);
-		if(strcmp(snd.format, "CS229") == 0){
-			parseCs229(&snd);
-		} else {
-			parseAiff(&snd);
-		}
-		
-		fclose(snd.stream); /* close file after parsing */
-		snd.duration = ((float)snd.samples)/snd.sampleRate; /* duration in seconds */
+	if(numFiles == 0){ /* if no files were given */
+		readInfo(handle, stdin, "(standard input)", fullParse); /* read from standard input */
+		fclose(stdin); /* close file after parsing */
 		
-		printSndInfo(&snd);
+		printSndInfo(handleSound(handle));
 	}
 	
 	printf("----------------------------------------------------------------------\n");	
+	sndClose(handle);
 	return 0;
 }
\ No newline at end of file
@@ -8,9 +8,11 @@
 *	and displays an ASCII art representation of the sample data
 */
 int main(int argc, char *argv[]){
+	argc = statsSwitch(argc, argv);
 	int c = -1; /* number of channels, -1 means all */
 	int w = 80; /* total output width */
-	int n = 1; /* zoom factor */
+	int zooms[argc]; /* zoom factors, each is rendered in turn */
+	int numZooms = 0;
 	
 	int i;
 	int j;
@@ -43,6 +45,10 @@ int main(int argc, char *argv[]){
 			fprintf(stderr, "\t-z n: Zoom out by a factor of n. If not specified, the default is n = 1\n");
 			fprintf(stderr, "\t\t The value to plot should be the largest magnitude value over n consecutive samples,\n");
 			fprintf(stderr, "\t\t and the number of lines of output should decrease by about a factor of n\n");
+			fprintf(stderr, "\t\t -z may be given more than once, to render the file at each zoom factor in turn\n");
+			fprintf(stderr, "\t-m n: Keep at most n megabytes of decoded samples in memory while rendering more than one zoom factor.\n");
+			fprintf(stderr, "\t\t If not specified, the default is %ld\n", CACHE_BUDGET / (1024*1024));
+			fprintf(stderr, "\t--stats: Print the time of each phase, the bytes and frames read and the memory used to standard error\n");
 			return 0;
 		
 		} else if(strcmp(argv[i], "-c") == 0){ /* show the output only for channel c */
@@ -53,7 +59,7 @@ int main(int argc, char *argv[]){
 			}
 			
 			for(j = 0; j < strlen(argv[i]); j++){
-				if(argv[i][j] <= '0' || argv[i][j] > '9'){ /* if not a number or zero*/
+				if(argv[i][j] < '0' || argv[i][j] > '9' || atoi(argv[i]) == 0){ /* if not a number or zero*/
 					fprintf(stderr, "Error: given c value, %s, is invalid\n", argv[i]);
 					exit(EXIT_FAILURE);
 				}
@@ -94,71 +100,105 @@ int main(int argc, char *argv[]){
 			}
 			
 			for(j = 0; j < strlen(argv[i]); j++){
-				if(argv[i][j] <= '0' || argv[i][j] > '9'){ /* if not a number or zero*/
+				if(argv[i][j] < '0' || argv[i][j] > '9' || atoi(argv[i]) == 0){ /* if not a number or zero*/
 					fprintf(stderr, "Error: given n value, %s, is invalid\n", argv[i]);
 					exit(EXIT_FAILURE);
 				}
 			}
-			n = atoi(argv[i]); /* n equal the given value */
-
+			zooms[numZooms++] = atoi(argv[i]); /* n equal the given value */
+		
+		} else if(strcmp(argv[i], "-m") == 0){ /* bytes of decoded blocks kept at once */
+			i++;
+			if(i == argc){
+				fprintf(stderr, "Error: no value given after switch -m");
+				exit(EXIT_FAILURE);
+			}
+			setCacheBudget(sharedCache(), (long)parseMegabytes(argv[i]) * 1024 * 1024);
+		
 		} else { /* invalid argument */
 			fprintf(stderr, "Error: invalid argument %s", argv[i]);
 			exit(EXIT_FAILURE);
 		}
 	}
+	setvbuf(stdout, NULL, _IOFBF, WRITE_BLOCK); /* whole lines are written, so a bigger buffer means fewer writes */
 	soundfile_t snd;
 	initSoundfile(&snd);
 	snd.stream = stdin; /* read from standard input */
+	statsPhase("header");
 	setFormat(&snd); /* get info from file */
-	if(strcmp(snd.format, "AIFF") == 0){
-		parseAiff(&snd);
-	} else {
-		parseCs229(&snd);
+	if(numZooms <= 1){ /* a single render is printed as the samples are read, holding only the current line */
+		showstate_t show;
+		show.snd = &snd;
+		show.n = (numZooms == 1) ? zooms[0] : 1; /* the default is n = 1 */
+		show.c = c;
+		show.w = w;
+		show.line = 0;
+		show.inLine = 0;
+		show.peaks = NULL;
+		statsPhase("render");
+		readBlocks(&snd, showBlock, &show);
+		finishShow(&show);
+		statsFrames(snd.samples);
+		return 0;
 	}
-	int displayed = 0; /* amount of channels displayed */
-	if(c == -1){ /* if all the channels */
-		displayed = (snd.samples * snd.channels)/n; /* display all the channels of the samples in regard to zoom factor */
-		if((snd.samples * snd.channels) % n){
-			displayed++;
-		}
-	} else if(c <= snd.channels){ /* if given channel is less or equal to the number of samples */
-		displayed = snd.samples/n; /* display the selected channels in regard to zoom factor */
-		if((snd.samples) % n){
-			displayed++;
+	
+	statsPhase("parse");
+	if(strcmp(snd.format, "AIFF") == 0){
+		if(!mapAiff(&snd)){ /* samples are decoded as they are shown if the file can be mapped */
+			parseAiff(&snd);
 		}
+	} else if(strcmp(snd.format, "CS229B") == 0){
+		parseCs229b(&snd); /* raw samples are mapped, so they are only read as they are shown */
 	} else {
+		parseHeader(&snd);
+		if(!indexCs229(&snd)){ /* samples are parsed a block at a time as they are shown if stdin can seek */
+			parseData(&snd);
+		}
+	}
+	if(c > snd.channels){
 		fprintf(stderr, "Error: specified number of channels is greater than the number of samples\n");
 		exit(EXIT_FAILURE);
 	}
 	
-	int allDisplayed[displayed];
-	int index = 0;
-	for(i = 0; i < snd.samples; i += n){ /* go through the samples, increasing index by the zoom factor */
-		for(j = 1; j <= snd.channels; j++){
-			if((c == j) || (c == -1)){ /* display only the chosen channel or all the channels if -1*/
-				allDisplayed[index] = zoomSample(i*snd.channels + (j - 1), n, &snd); /* the greatest magnitude sample value of n number of samples */
-				index++;
-			}
+	statsFrames(snd.samples);
+	
+	statsPhase("pyramid");
+	pyramid_t pyramid; /* built once, then every zoom factor is answered from it */
+	pyramid.numLevels = 0;
+	for(i = 0; i < numZooms; i++){
+		if(zooms[i] > PEAK_BASE && pyramid.numLevels == 0){
+			buildPyramid(&pyramid, &snd);
 		}
 	}
 	
-	/* print out the values */
-	char *buffer = calloc(9, 1); /* first part is 9 chars long */
-	for(i = 0; i < displayed/snd.channels; i++){ /* put the sample number in the first 9 chars */
-		sprintf(buffer, "%d", i);
-		for(j = 0; j < (9 - strlen(buffer)); j ++) { /* the first chars are spaces, then the number*/
-			fprintf(stdout, " ");
+	/* print out the values as they are found, the greatest magnitude sample value of n number of samples */
+	statsPhase("render");
+	int *values = malloc(snd.channels * sizeof(int));
+	int z;
+	for(z = 0; z < numZooms; z++){
+		int n = zooms[z];
+		int displayed = snd.samples/n; /* lines of output, each with n frames */
+		if(snd.samples % n){
+			displayed++;
 		}
-		fprintf(stdout, "%s|", buffer); /* the number should be "right justified" */
-		printDisplayed(allDisplayed[i*snd.channels], snd.bitDepth, w); /* print out the dash bar representation */
 		
-		if(c == -1) { /* for more than 1 channel */
-			for(j = 1; j < snd.channels; j++){
-				fprintf(stdout, "         |"); /* for multiple channels, we don't show a number */
-				printDisplayed(allDisplayed[i*snd.channels + j] , snd.bitDepth, w); /* print out the dash bar representation */
+		for(i = 0; i < displayed; i++){
+			for(j = 0; j < snd.channels; j++){
+				if(n > PEAK_BASE){
+					values[j] = pyramidPeak(&pyramid, &snd, j, i*n, i*n + n).peak;
+				} else {
+					values[j] = zoomSample(i*n, j, n, &snd);
+				}
 			}
+			printShowLine(i, values, snd.channels, c, snd.bitDepth, w);
 		}
 	}
 	
+	free(values);
+	if(pyramid.numLevels > 0){
+		freePyramid(&pyramid);
+	}
+	unmapAiff(&snd);
+	freeCs229Index(&snd);
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,234 @@
+/* Author: Seth George */
+
+#include "sndutil.h"
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+#define REPEATS 3 /* each case is run this many times, the fastest is reported */
+#define MAX_SIZES 8
+
+typedef struct {
+	char *format; /* "aiff" or "cs229" */
+	int bitDepth;
+	int channels;
+} input_t;
+
+typedef struct {
+	char *name;
+	char *format; /* the input format the case runs on */
+	char *args[6]; /* program, then its arguments, INPUT is replaced by the input file */
+	int stdinInput; /* 1 if the input is given on standard input rather than as an argument */
+	int numInputs; /* times the input is read, sndcat is given it twice */
+} case_t;
+
+char binDir[MAX_NAME_LENGTH]; /* where the programs being timed are */
+char tempDir[] = "/tmp/sndtime.XXXXXX"; /* where the generated inputs are written */
+
+/**
+*	Seconds on the monotonic clock
+*/
+double now(){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+*	Runs a program from binDir with its standard input and output on the given files,
+*	and waits for it. Returns its peak resident set size in kilobytes, exits if the program fails
+*/
+long runProgram(char *args[], char *in, char *out){
+	char path[MAX_NAME_LENGTH * 2];
+	snprintf(path, sizeof(path), "%s/%s", binDir, args[0]);
+	pid_t pid = fork();
+	if(pid == -1){
+		fprintf(stderr, "Error: could not start %s\n", args[0]);
+		exit(EXIT_FAILURE);
+	} else if(pid == 0){
+		int from = open(in, O_RDONLY);
+		int to = open(out, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if(from == -1 || to == -1){
+			fprintf(stderr, "Error: could not open %s or %s\n", in, out);
+			_exit(EXIT_FAILURE);
+		}
+		dup2(from, STDIN_FILENO);
+		dup2(to, STDOUT_FILENO);
+		execv(path, args);
+		fprintf(stderr, "Error: could not run %s\n", path);
+		_exit(EXIT_FAILURE);
+	}
+	
+	int status;
+	struct rusage usage;
+	if(wait4(pid, &status, 0, &usage) == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0){
+		fprintf(stderr, "Error: %s failed\n", args[0]);
+		exit(EXIT_FAILURE);
+	}
+	return usage.ru_maxrss;
+}
+
+/**
+*	Writes a generated input of the given size into tempDir with sndgen, and returns its frames
+*/
+long generateInput(input_t *input, int megabytes, char *path){
+	long frames = (long)megabytes * 1024 * 1024 / (input->channels * (input->bitDepth / 8));
+	if(strcmp(input->format, "cs229") == 0){ /* the same frames as the AIFF file, the text is bigger */
+		frames = frames * (input->bitDepth / 8) / ((input->bitDepth == 8) ? 4 : (input->bitDepth == 16) ? 6 : 10);
+	}
+	char bits[16];
+	char channels[16];
+	char count[32];
+	snprintf(bits, sizeof(bits), "%d", input->bitDepth);
+	snprintf(channels, sizeof(channels), "%d", input->channels);
+	snprintf(count, sizeof(count), "%ld", frames);
+	snprintf(path, MAX_NAME_LENGTH, "%s/gen%d_%d_%dmb.%s", tempDir, input->bitDepth, input->channels, megabytes, input->format);
+	
+	char *args[] = {"sndgen", strcmp(input->format, "cs229") == 0 ? "-c" : "-a", "-b", bits, "-n", channels, "-s", count, NULL};
+	runProgram(args, "/dev/null", path);
+	return frames;
+}
+
+/**
+*	Times a case on a generated input REPEATS times, and prints a line for the fastest run
+*/
+void runCase(case_t *bench, char *input, input_t *info, long frames){
+	char *args[8];
+	int i;
+	int j;
+	for(i = 0; bench->args[i]; i++){
+		args[i] = (strcmp(bench->args[i], "INPUT") == 0) ? input : bench->args[i];
+	}
+	args[i] = NULL;
+	
+	struct stat st;
+	stat(input, &st);
+	long bytes = st.st_size * bench->numInputs;
+	frames *= bench->numInputs;
+	
+	double best = 0;
+	long rss = 0;
+	for(j = 0; j < REPEATS; j++){
+		double start = now();
+		long peak = runProgram(args, bench->stdinInput ? input : "/dev/null", "/dev/null");
+		double secs = now() - start;
+		if(j == 0 || secs < best){
+			best = secs;
+		}
+		if(peak > rss){
+			rss = peak;
+		}
+	}
+	
+	char *name = strrchr(input, '/') + 1;
+	printf("%s\t%s\t%d\t%d\t%ld\t%ld\t%.4f\t%.1f\t%.0f\t%ld\n", bench->name, name, info->bitDepth, info->channels,
+		frames, bytes, best, bytes / best / (1024 * 1024), frames / best, rss);
+	fflush(stdout);
+}
+
+/**
+*	End to end benchmarks for the programs, run on generated inputs of each format, bit depth and channel count.
+*	Prints one tab separated line per case and input. Only the cases named as arguments are run, or all of them
+*/
+int main(int argc, char *argv[]){
+	int sizes[MAX_SIZES] = {2, 16}; /* megabytes of sample data in each input */
+	int numSizes = 2;
+	int userSizes = 0;
+	int first = argc;
+	int i;
+	int j;
+	int k;
+	
+	for(i = 1; i < argc; i++){
+		if(strcmp(argv[i], "-h") == 0){
+			fprintf(stderr, "\nsndtime times the programs end to end on generated AIFF and CS229 files of several\n");
+			fprintf(stderr, "bit depths, channel counts and sizes. It prints a tab separated line per case and input with\n");
+			fprintf(stderr, "the frames and bytes read, the fastest of %d runs in seconds, MB/s, frames/s and the peak RSS in KB.\n", REPEATS);
+			fprintf(stderr, "The programs, and sndgen which makes the inputs, are run from the directory sndtime is in.\n");
+			fprintf(stderr, "Arguments may be passed as:\n");
+			fprintf(stderr, "\t$ sndtime [-s megabytes] ... [case] [case] ...\n");
+			fprintf(stderr, "\t-s n: Generate inputs with about n megabytes of samples, may be given more than once.\n");
+			fprintf(stderr, "\t\t The default is 2 and 16\n");
+			fprintf(stderr, "The cases are: info info-full conv-to-cs229 conv-to-aiff cat cut show show-zoom\n");
+			return 0;
+		} else if(strcmp(argv[i], "-s") == 0 && i + 1 < argc){
+			int megabytes = atoi(argv[++i]);
+			if(megabytes <= 0 || userSizes == MAX_SIZES){
+				fprintf(stderr, "Error: size must be a positive number of megabytes, given at most %d times\n", MAX_SIZES);
+				exit(EXIT_FAILURE);
+			}
+			sizes[userSizes++] = megabytes;
+			numSizes = userSizes;
+		} else {
+			first = i;
+			break;
+		}
+	}
+	
+	input_t inputs[] = {
+		{"aiff", 8, 1}, {"aiff", 16, 2}, {"aiff", 24, 2}, {"aiff", 32, 1},
+		{"cs229", 8, 1}, {"cs229", 16, 2}, {"cs229", 32, 1},
+	};
+	case_t cases[] = {
+		{"info", "", {"sndinfo", "INPUT", NULL}, 0, 1},
+		{"info-full", "", {"sndinfo", "-f", "INPUT", NULL}, 0, 1},
+		{"conv-to-cs229", "aiff", {"sndconv", "-c", NULL}, 1, 1},
+		{"conv-to-aiff", "cs229", {"sndconv", "-a", NULL}, 1, 1},
+		{"cat", "", {"sndcat", "INPUT", "INPUT", NULL}, 0, 2},
+		{"cut", "", {"sndcut", "1000..200000", NULL}, 1, 1},
+		{"show", "", {"sndshow", NULL}, 1, 1},
+		{"show-zoom", "", {"sndshow", "-z", "100", "-z", "1000", NULL}, 1, 1},
+	};
+	int numInputs = sizeof(inputs) / sizeof(inputs[0]);
+	int numCases = sizeof(cases) / sizeof(cases[0]);
+	
+	for(i = first; i < argc; i++){
+		int found = 0;
+		for(j = 0; j < numCases; j++){
+			if(strcmp(argv[i], cases[j].name) == 0){
+				found = 1;
+			}
+		}
+		if(!found){
+			fprintf(stderr, "Error: invalid case %s\n", argv[i]);
+			exit(EXIT_FAILURE);
+		}
+	}
+	
+	char self[MAX_NAME_LENGTH]; /* dirname may change its argument */
+	strncpy(self, argv[0], MAX_NAME_LENGTH - 1);
+	self[MAX_NAME_LENGTH - 1] = '\0';
+	strcpy(binDir, dirname(self));
+	if(mkdtemp(tempDir) == NULL){
+		fprintf(stderr, "Error: could not make a directory for the inputs\n");
+		exit(EXIT_FAILURE);
+	}
+	
+	printf("# case\tinput\tbits\tchannels\tframes\tbytes\tseconds\tMB/s\tframes/s\tpeak_rss_kb\n");
+	fflush(stdout);
+	for(k = 0; k < numSizes; k++){
+		for(i = 0; i < numInputs; i++){
+			char input[MAX_NAME_LENGTH];
+			long frames = generateInput(&inputs[i], sizes[k], input);
+			for(j = 0; j < numCases; j++){
+				int run = (first >= argc);
+				int a;
+				for(a = first; a < argc; a++){
+					if(strcmp(argv[a], cases[j].name) == 0){
+						run = 1;
+					}
+				}
+				if(run && (cases[j].format[0] == '\0' || strcmp(cases[j].format, inputs[i].format) == 0)){
+					runCase(&cases[j], input, &inputs[i], frames);
+				}
+			}
+			unlink(input);
+		}
+	}
+	rmdir(tempDir);
+	return 0;
+}
@@ -1,7 +1,16 @@
 /* Author: Seth George */
 
 #include "sndutil.h"
+#include "aiffutil.h"
+#include "cs229util.h"
 #include <ncurses.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <stdarg.h>
+
+stats_t stats; /* what --stats reports, zero until it is given */
+__thread sndcontext_t *activeContext = NULL;
 
 /**
 *	Set all int variables in struct to zero
@@ -13,6 +22,16 @@ void initSoundfile(soundfile_t *snd){
 	snd->channels = 0;
 	snd->duration = 0;
 	snd->numBytes = 0;
+	static int nextId = 0;
+	snd->sampleData = NULL; /* until the samples are read */
+	snd->mapped = NULL;
+	snd->offsets = NULL;
+	snd->numOffsets = 0;
+	snd->reader = NULL;
+	snd->readerBlock = -1;
+	snd->id = __atomic_add_fetch(&nextId, 1, __ATOMIC_RELAXED); /* handles may be read on several threads */
+	snd->coding = SND_CODING_RAW;
+	snd->byteSwapped = 0;
 }
 
 /**
@@ -20,16 +39,15 @@ void initSoundfile(soundfile_t *snd){
 */
 void keywordsAreSet(soundfile_t *snd){
 	if((snd->sampleRate == 0)||(snd->bitDepth == 0)||(snd->channels == 0)){
-		fprintf(stderr, "Error: Missing required keyword\n");
-		exit(EXIT_FAILURE);
+		sndFail(SND_ERR_FORMAT, "Missing required keyword\n");
 	}
 }
 
 /**
 *	Print out the parsed file info
-*	Print information about the sound file
+*	Print information about the sound file to the stream to
 */
-void printSndInfo(soundfile_t *snd){
+void writeSndInfo(soundfile_t *snd, FILE *to){
 	float secs = snd->duration;
 	int hrs;
 	int mins;
@@ -40,55 +58,140 @@ void printSndInfo(soundfile_t *snd){
 	mins = secs / 60;
 	secs -= mins * 60;
 	
-	printf("----------------------------------------------------------------------\n");
-	printf("Filename: %s\n", snd->name);
-	printf("Format: %s\n", snd->format);
-	printf("Sample Rate: %d\n", snd->sampleRate);
-	printf("Bit Depth: %d\n", snd->bitDepth);
-	printf("Channels: %d\n", snd->channels);
-	printf("Samples: %d\n", snd->samples);
-	printf("Duration: %d:%d:%.2f\n", hrs, mins, secs);
+	fprintf(to, "----------------------------------------------------------------------\n");
+	fprintf(to, "Filename: %s\n", snd->name);
+	fprintf(to, "Format: %s\n", snd->format);
+	fprintf(to, "Sample Rate: %d\n", snd->sampleRate);
+	fprintf(to, "Bit Depth: %d\n", snd->bitDepth);
+	fprintf(to, "Channels: %d\n", snd->channels);
+	fprintf(to, "Samples: %d\n", snd->samples);
+	fprintf(to, "Duration: %d:%d:%.2f\n", hrs, mins, secs);
 }
 
 /**
-*	Prints the sample data
+*	Prints the stats of a sound file to standard output
 */
-void printDisplayed(int value, int bitDepth, int w){
-	int max = power(2, bitDepth -1)-1; /* maximum possible value for bit depth */
-	int sign = 1;
-	if(value < 0) {
-		sign = -1;
+void printSndInfo(soundfile_t *snd){
+	writeSndInfo(snd, stdout);
+}
+
+/**
+*	The bars for a bit depth and output width, built the first time they are asked for.
+*	There are only about w of them, so each sample is drawn by copying one
+*/
+bartable_t *barTable(int bitDepth, int w){
+	static bartable_t table; /* the last one built, sndshow uses one bit depth and width */
+	if(table.bars && table.bitDepth == bitDepth && table.w == w){
+		return &table;
 	}
+	free(table.thresholds);
+	free(table.bars);
+	free(table.offsets);
+	free(table.lengths);
+	
+	table.bitDepth = bitDepth;
+	table.w = w;
+	table.avalible = (w - 12)/2;
+	table.max = (int)((1LL << (bitDepth - 1)) - 1); /* maximum possible value for bit depth */
+	long long largest = (long long)table.max + 1; /* magnitude of the most negative value */
+	table.maxDashes = floatDashes(largest, table.max, table.avalible);
 	
-	float ratio = (float)value*sign / max; /* ratio equals value/max value */
-	int avalible = (w - 12)/2;
-	int dashes = ratio * avalible + 0.5f; /* rounding up at .5 */
+	table.thresholds = malloc((table.maxDashes + 1) * sizeof(long long));
+	int d;
+	for(d = 0; d <= table.maxDashes; d++){ /* binary search, the dashes never go down as the magnitude goes up */
+		long long low = 0;
+		long long high = largest;
+		while(low < high){
+			long long middle = low + (high - low)/2;
+			if(floatDashes(middle, table.max, table.avalible) >= d){
+				high = middle;
+			} else {
+				low = middle + 1;
+			}
+		}
+		table.thresholds[d] = low;
+	}
 	
+	int longest = table.avalible*2 + table.maxDashes + 3;
+	table.bars = malloc((long)(table.maxDashes + 1) * 2 * longest);
+	table.offsets = malloc((table.maxDashes + 1) * 2 * sizeof(int));
+	table.lengths = malloc((table.maxDashes + 1) * 2 * sizeof(int));
+	char *at = table.bars;
 	int i;
-	if(value < 0){
-		for(i = 0; i < avalible - dashes; i++){
-			fprintf(stdout, " ");
+	for(d = 0; d <= table.maxDashes; d++){
+		table.offsets[d*2] = at - table.bars; /* negative */
+		for(i = 0; i < table.avalible - d; i++){
+			*at++ = ' ';
 		}
-		for(i = 0; i < dashes; i++){
-			fprintf(stdout, "-");
+		for(i = 0; i < d; i++){
+			*at++ = '-';
 		}
-		fprintf(stdout, "|");
-		for(i = 0; i < avalible; i++){
-			fprintf(stdout, " ");
+		*at++ = '|';
+		for(i = 0; i < table.avalible; i++){
+			*at++ = ' ';
 		}
-	} else {
-		for(i = 0; i < avalible; i++){
-			fprintf(stdout, " ");
+		*at++ = '|';
+		*at++ = '\n';
+		table.lengths[d*2] = (at - table.bars) - table.offsets[d*2];
+		
+		table.offsets[d*2 + 1] = at - table.bars; /* positive */
+		for(i = 0; i < table.avalible; i++){
+			*at++ = ' ';
 		}
-		fprintf(stdout, "|");
-		for(i = 0; i < dashes; i++){
-			fprintf(stdout, "-");
+		*at++ = '|';
+		for(i = 0; i < d; i++){
+			*at++ = '-';
 		}
-		for(i = 0; i < avalible - dashes; i++){
-			fprintf(stdout, " ");
+		for(i = 0; i < table.avalible - d; i++){
+			*at++ = ' ';
 		}
+		*at++ = '|';
+		*at++ = '\n';
+		table.lengths[d*2 + 1] = (at - table.bars) - table.offsets[d*2 + 1];
+	}
+	return &table;
+}
+
+/**
+*	Dashes drawn for a magnitude by the float ratio that sndshow has always used, only used to build the bar table
+*/
+int floatDashes(long long magnitude, int max, int avalible){
+	float ratio = (float)magnitude / max; /* ratio equals value/max value */
+	return ratio * avalible + 0.5f; /* rounding up at .5 */
+}
+
+/**
+*	Dashes drawn for a magnitude, in integers: a first guess, then moved to the right threshold
+*/
+int barDashes(bartable_t *table, long long magnitude){
+	int d = (magnitude * table->avalible) / table->max;
+	if(d > table->maxDashes){
+		d = table->maxDashes;
 	}
-	fprintf(stdout, "|\n");
+	while(d < table->maxDashes && magnitude >= table->thresholds[d + 1]){
+		d++;
+	}
+	while(d > 0 && magnitude < table->thresholds[d]){
+		d--;
+	}
+	return d;
+}
+
+/**
+*	The bar for value, ending with "|\n", and its length
+*/
+const char *barFor(int value, int bitDepth, int w, int *length){
+	bartable_t *table = barTable(bitDepth, w);
+	long long magnitude = value;
+	int index;
+	if(value < 0){
+		magnitude = -magnitude;
+		index = barDashes(table, magnitude) * 2;
+	} else {
+		index = barDashes(table, magnitude) * 2 + 1;
+	}
+	*length = table->lengths[index];
+	return table->bars + table->offsets[index];
 }
 
 /**
@@ -96,8 +199,7 @@ void printDisplayed(int value, int bitDepth, int w){
 */
 void setFormat(soundfile_t *snd){
 	if(!snd->stream){ /* invalid file pointer */
-		fprintf(stderr, "Error: invalid file, please give a valid file path\n");
-		exit(EXIT_FAILURE);
+		sndFail(SND_ERR_IO, "invalid file, please give a valid file path\n");
 	} else { /* valid file pointer */
 		char test[5];
 		fgets(test, 5, snd->stream);
@@ -107,42 +209,44 @@ void setFormat(soundfile_t *snd){
 			snd->format[5] = 0;
 		} else if(strncmp("CS22", test, 4) == 0){
 			if(fgetc(snd->stream) == '9'){ /* check if the next byte is 9 */
-				strncpy(snd->format, "CS229", 6);
+				int next = fgetc(snd->stream);
+				if(next == 'B'){ /* CS229B, the binary sibling */
+					strcpy(snd->format, "CS229B");
+				} else {
+					ungetc(next, snd->stream);
+					strncpy(snd->format, "CS229", 6);
+				}
 			} else {
-				fprintf(stdout, "Error: did not find valid file format identifier, found %s", test);
-				exit(EXIT_FAILURE);
+				sndFailTo(stdout, SND_ERR_FORMAT, "did not find valid file format identifier, found %s", test);
 			}
 		} else {
-			fprintf(stdout, "Error: did not find valid file format identifier, found %s\n", test);
-			exit(EXIT_FAILURE);
+			sndFailTo(stdout, SND_ERR_FORMAT, "did not find valid file format identifier, found %s\n", test);
 		}
 	}
 }
 
-dataCut(int low[], int high[], int numRestrictions, soundfile_t *snd){
-	int *data = malloc(snd->samples * snd->channels * sizeof(int));
-	int i, j, count = 0;
-	for(i = 0; i < snd->samples; i++) { /* for each sample */
-		for(j = 0; j < numRestrictions; j++) { /* go through the [low..high] values */
-			if((i >= low[j]) && (i <= high[j])){ /* if it is in "cut" range */
-				i = high[j] + 1;
-			}
-		}
-		
-		if(i >= snd->samples){
-			break;
-		}
-		
-		for(j = 0; j < snd->channels; j++){ /*add every channel in the sample */
-			data[count] = snd->sampleData[i*snd->channels + j];
-			count++;
-		}
+/**
+*	Removes the [low..high] ranges of samples by moving each kept run down in one go.
+*	The ranges must already be sorted and merged, by mergeRanges in the caller, so they are merged once
+*/
+void dataCut(int low[], int high[], int numRestrictions, soundfile_t *snd){
+	int frameBytes = snd->channels * sampleWidth(snd->bitDepth); /* every channel of a sample */
+	char *data = snd->sampleData;
+	int count = 0;
+	int range = 0;
+	int start, spanEnd;
+	for(start = keptSpan(0, snd->samples, low, high, numRestrictions, &range, &spanEnd); start < snd->samples;
+			start = keptSpan(spanEnd, snd->samples, low, high, numRestrictions, &range, &spanEnd)){
+		memmove(data + (long)count*frameBytes, data + (long)start*frameBytes, (long)(spanEnd - start) * frameBytes); /* the run only moves down */
+		count += spanEnd - start;
 	}
 	
-	data = realloc(data, count * sizeof(int)); /* cut off the extra off the end */
-	free(snd->sampleData);
-	snd->sampleData = data; /* point to the modified data */
-	snd->samples = count/snd->channels;
+	snd->samples = count;
+	if(snd->mapped){ /* CS229B samples used in place, only the kept ones are copied out */
+		ownCs229b(snd);
+	} else {
+		snd->sampleData = realloc(data, (long)count * frameBytes + 1); /* cut off the extra off the end */
+	}
 	snd->numBytes = snd->channels*snd->samples*snd->bitDepth/8;
 	
 }
@@ -150,75 +254,795 @@ dataCut(int low[], int high[], int numRestrictions, soundfile_t *snd){
 /**
 *	Pastes the buffer into the sampleData at the location given by insertSample
 */
-void dataCat(int insertSample, int *insertBuffer, int bufferSize, soundfile_t *snd){
+void dataCat(int insertSample, void *insertBuffer, int bufferSize, soundfile_t *snd){
+	int width = sampleWidth(snd->bitDepth);
 	int saveDataSize = (snd->samples - insertSample) * snd->channels;
-	int saveData[saveDataSize];
-	int i;
-	for(i = 0; i < saveDataSize; i++){ /* store all the samples that would be overwritten */
-		saveData[i] = snd->sampleData[i + (insertSample * snd->channels)];
-	}
+	ownCs229b(snd); /* the sample data grows, which a mapping cannot */
+	
 	/* change values in snd */
 	snd->samples += bufferSize/snd->channels;
 	snd->numBytes += bufferSize*snd->bitDepth/8;
-	snd->sampleData = realloc(snd->sampleData, (snd->numBytes/(snd->bitDepth/8))*sizeof(int));
-		
-	for(i = 0; i < bufferSize; i++){ /* insert the buffer into the sampleData */
-		snd->sampleData[i + (insertSample * snd->channels)] = insertBuffer[i];
-	}
+	snd->sampleData = realloc(snd->sampleData, snd->samples*snd->channels*width);
 	
-	for(i = 0; i < saveDataSize; i++){ /* reinsert the stored samples */
-		snd->sampleData[i + (insertSample * snd->channels) + bufferSize] = saveData[i];
-	}
+	char *insertAt = (char *)snd->sampleData + insertSample*snd->channels*width;
+	memmove(insertAt + bufferSize*width, insertAt, saveDataSize*width); /* move the samples that would be overwritten */
+	memcpy(insertAt, insertBuffer, bufferSize*width); /* insert the buffer into the sampleData */
 }
 
 /**
-*	Takes in an index, number of values per sample, and number of samples n
-*	outputs the greatest magnitude sample value of n number of samples
+*	Takes in a frame, a channel, and number of frames n
+*	outputs the greatest magnitude sample value of that channel over the n frames, the first if there is a tie
 */
-int zoomSample(int index, int n, soundfile_t *snd){
+int zoomSample(int frame, int channel, int n, soundfile_t *snd){
 	int max;
-	int isNeg = 0;
-	int maxIsNeg = 0;
 	int isFirst = 1;
 	int i;
-	int j;
-	for(i = index; i < index + n; i+= snd->channels){
-		if(i >= (snd->samples*snd->channels)){
-			break;
-		}
-		
+	for(i = frame; i < frame + n && i < snd->samples; i++){
+		int value = getSample(snd, i*snd->channels + channel);
 		if(isFirst){
-			max = snd->sampleData[i];
+			max = value;
 			isFirst = 0;
+		} else if(abs(value) > abs(max)){ /* the first of the greatest magnitude is kept */
+			max = value;
 		}
-		
-		if(snd->sampleData[i] < 0){
-			snd->sampleData[i] *= -1;
-			isNeg = 1;
+	}
+	
+	if(isFirst){
+		sndFail(SND_ERR_ARGUMENT, "no numbers given to determine the greatest magnitude: frame %d\n", frame);
+	}
+	
+	return max;
+}
+
+/**
+*	Builds the min/max pyramid of snd in one pass over its sample data, which is only read.
+*	Level 0 summarizes PEAK_BASE frames per node, and each level above it summarizes two nodes of the one below
+*/
+void buildPyramid(pyramid_t *pyramid, soundfile_t *snd){
+	int channels = snd->channels;
+	int nodes = (snd->samples + PEAK_BASE - 1) / PEAK_BASE;
+	pyramid->channels = channels;
+	pyramid->numLevels = 1;
+	int count;
+	for(count = nodes; count > 1; count = (count + 1) / 2){
+		pyramid->numLevels++;
+	}
+	pyramid->levels = malloc(pyramid->numLevels * sizeof(peak_t *));
+	pyramid->numNodes = malloc(pyramid->numLevels * sizeof(int));
+	
+	peak_t *level = malloc(((long)nodes * channels + 1) * sizeof(peak_t));
+	int frame;
+	int j;
+	for(frame = 0; frame < snd->samples; frame += BLOCK_FRAMES){ /* a block at a time, so mapped files are decoded once */
+		const void *block = frameBlock(snd, frame / BLOCK_FRAMES);
+		int width = sampleWidth(snd->bitDepth);
+		int numFrames = (snd->samples - frame < BLOCK_FRAMES) ? snd->samples - frame : BLOCK_FRAMES;
+		int i;
+		for(i = 0; i < numFrames; i++){
+			peak_t *node = &level[((frame + i) / PEAK_BASE) * channels];
+			for(j = 0; j < channels; j++){
+				int value = readSample(block, width, i*channels + j);
+				if((frame + i) % PEAK_BASE == 0){ /* first frame of the node */
+					node[j].min = value;
+					node[j].max = value;
+					node[j].peak = value;
+				} else {
+					if(value < node[j].min){
+						node[j].min = value;
+					}
+					if(value > node[j].max){
+						node[j].max = value;
+					}
+					if(abs(value) > abs(node[j].peak)){
+						node[j].peak = value;
+					}
+				}
+			}
 		}
-		
-		if(snd->sampleData[i] > max){
-			max = snd->sampleData[i];
-			if(isNeg){
-				maxIsNeg = 1;
-			} else {
-				maxIsNeg = 0;
+	}
+	pyramid->levels[0] = level;
+	pyramid->numNodes[0] = nodes;
+	
+	int k;
+	for(k = 1; k < pyramid->numLevels; k++){ /* each level from pairs of the one below */
+		peak_t *below = pyramid->levels[k - 1];
+		int belowNodes = pyramid->numNodes[k - 1];
+		nodes = (belowNodes + 1) / 2;
+		level = malloc(((long)nodes * channels + 1) * sizeof(peak_t));
+		int i;
+		for(i = 0; i < nodes; i++){
+			for(j = 0; j < channels; j++){
+				if(i*2 + 1 < belowNodes){
+					level[i*channels + j] = combinePeaks(below[i*2*channels + j], below[(i*2 + 1)*channels + j]);
+				} else {
+					level[i*channels + j] = below[i*2*channels + j];
+				}
 			}
 		}
+		pyramid->levels[k] = level;
+		pyramid->numNodes[k] = nodes;
+	}
+}
+
+/**
+*	Frees every level of the pyramid
+*/
+void freePyramid(pyramid_t *pyramid){
+	int k;
+	for(k = 0; k < pyramid->numLevels; k++){
+		free(pyramid->levels[k]);
+	}
+	free(pyramid->levels);
+	free(pyramid->numNodes);
+	pyramid->numLevels = 0;
+}
+
+/**
+*	Summary of two runs of frames, first being the earlier
+*/
+peak_t combinePeaks(peak_t first, peak_t second){
+	peak_t both = first;
+	if(second.min < both.min){
+		both.min = second.min;
+	}
+	if(second.max > both.max){
+		both.max = second.max;
+	}
+	if(abs(second.peak) > abs(first.peak)){ /* the first of the greatest magnitude is kept */
+		both.peak = second.peak;
+	}
+	return both;
+}
+
+/**
+*	Summary of frames [frame..end) of a channel. Every step takes the largest pyramid node that starts at frame
+*	and fits, so a run of n frames costs about log(n) nodes plus under PEAK_BASE samples at each end
+*/
+peak_t pyramidPeak(pyramid_t *pyramid, soundfile_t *snd, int channel, int frame, int end){
+	peak_t result;
+	peak_t part;
+	int isFirst = 1;
+	if(end > snd->samples){
+		end = snd->samples;
+	}
+	
+	while(frame < end){
+		if(frame % PEAK_BASE == 0 && frame + PEAK_BASE <= end){
+			int k = 0;
+			while(k + 1 < pyramid->numLevels && frame % ((long)PEAK_BASE << (k + 1)) == 0 && frame + ((long)PEAK_BASE << (k + 1)) <= end){
+				k++;
+			}
+			part = pyramid->levels[k][(frame / (PEAK_BASE << k)) * pyramid->channels + channel];
+			frame += PEAK_BASE << k;
+		} else { /* the ends of the run, sample by sample */
+			int value = getSample(snd, frame*snd->channels + channel);
+			part.min = value;
+			part.max = value;
+			part.peak = value;
+			frame++;
+		}
 		
-		isNeg = 0;
+		result = isFirst ? part : combinePeaks(result, part);
+		isFirst = 0;
 	}
 	
 	if(isFirst){
-		fprintf(stderr, "Error: no numbers given to determine the greatest magnitude: index %d\n", index);
-		exit(EXIT_FAILURE);
+		sndFail(SND_ERR_ARGUMENT, "no numbers given to determine the greatest magnitude: frame %d\n", frame);
+	}
+	return result;
+}
+
+/**
+*	Prints one line of sndshow: the line number, then a bar for each channel shown, c is -1 for all of them
+*/
+void printShowLine(int line, int values[], int channels, int c, int bitDepth, int w){
+	static char *buffer = NULL; /* the whole line is put together here, then written at once */
+	static int size = 0;
+	bartable_t *table = barTable(bitDepth, w);
+	int needed = channels * (table->avalible*2 + table->maxDashes + 14) + 16;
+	if(needed > size){
+		size = needed;
+		buffer = realloc(buffer, size);
 	}
 	
-	if(maxIsNeg){
-		max *= -1;
+	char number[12];
+	int digits = formatInt(number, line) - number;
+	char *at = buffer;
+	int j;
+	for(j = digits; j < 9; j++){ /* the first chars are spaces, then the number */
+		*at++ = ' ';
 	}
+	memcpy(at, number, digits); /* the number should be "right justified" */
+	at += digits;
+	*at++ = '|';
 	
-	return max;
+	for(j = 0; j < channels; j++){
+		if(c != -1 && j != c - 1){ /* only channel c */
+			continue;
+		}
+		if(c == -1 && j > 0){
+			memcpy(at, "         |", 10); /* for multiple channels, we don't show a number */
+			at += 10;
+		}
+		int length;
+		const char *bar = barFor(values[j], bitDepth, w, &length); /* the dash bar representation */
+		memcpy(at, bar, length);
+		at += length;
+	}
+	fwrite(buffer, 1, at - buffer, stdout);
+}
+
+/**
+*	Gathers a block from readBlocks into the lines of the showstate_t arg, printing each line as it is finished.
+*	Only the current line is held, one value per channel
+*/
+void showBlock(void *arg, const void *data, int numFrames){
+	showstate_t *show = arg;
+	soundfile_t *snd = show->snd;
+	int channels = snd->channels;
+	int width = sampleWidth(snd->bitDepth);
+	if(show->c > channels){
+		sndFail(SND_ERR_ARGUMENT, "specified number of channels is greater than the number of samples\n");
+	}
+	if(!show->peaks){
+		show->peaks = malloc(channels * sizeof(int));
+	}
+	
+	int i;
+	int j;
+	for(i = 0; i < numFrames; i++){
+		for(j = 0; j < channels; j++){
+			int value = readSample(data, width, i*channels + j);
+			if(show->inLine == 0 || abs(value) > abs(show->peaks[j])){ /* the first of the greatest magnitude is kept */
+				show->peaks[j] = value;
+			}
+		}
+		show->inLine++;
+		
+		if(show->inLine == show->n){
+			printShowLine(show->line, show->peaks, channels, show->c, snd->bitDepth, show->w);
+			show->line++;
+			show->inLine = 0;
+		}
+	}
+}
+
+/**
+*	Prints the last line, if the samples ended part way through it, and frees the line
+*/
+void finishShow(showstate_t *show){
+	if(show->c > show->snd->channels){
+		sndFail(SND_ERR_ARGUMENT, "specified number of channels is greater than the number of samples\n");
+	}
+	if(show->inLine > 0){
+		printShowLine(show->line, show->peaks, show->snd->channels, show->c, show->snd->bitDepth, show->w);
+	}
+	free(show->peaks);
+	show->peaks = NULL;
+}
+
+/**
+*	Bytes used to store one sample of the given bit depth: 1, 2 or 4
+*/
+int sampleWidth(int bitDepth){
+	if(bitDepth <= 8){
+		return 1;
+	} else if(bitDepth <= 16){
+		return 2;
+	}
+	return 4;
+}
+
+/**
+*	Returns the value at index of sample data stored width bytes per sample
+*/
+int readSample(const void *data, int width, int index){
+	if(width == 1){
+		return ((const int8_t *)data)[index];
+	} else if(width == 2){
+		return ((const int16_t *)data)[index];
+	}
+	return ((const int32_t *)data)[index];
+}
+
+/**
+*	Stores the value at index of sample data stored width bytes per sample
+*/
+void writeSample(void *data, int width, int index, int value){
+	if(width == 1){
+		((int8_t *)data)[index] = value;
+	} else if(width == 2){
+		((int16_t *)data)[index] = value;
+	} else {
+		((int32_t *)data)[index] = value;
+	}
+}
+
+/**
+*	Returns the value at index of the sample data, from its block in the cache if the samples were not read whole
+*/
+int getSample(soundfile_t *snd, int index){
+	int width = sampleWidth(snd->bitDepth);
+	if(snd->sampleData){
+		return readSample(snd->sampleData, width, index);
+	}
+	
+	int blockValues = BLOCK_FRAMES * snd->channels;
+	int block = index / blockValues;
+	return readSample(frameBlock(snd, block), width, index - block*blockValues);
+}
+
+/**
+*	Returns the sample data of the block of BLOCK_FRAMES frames. A mapped or indexed file's block is
+*	decoded into the shared block cache the first time, and is only decoded again once it has been dropped.
+*	The data stays valid until the next block is asked for
+*/
+const void *frameBlock(soundfile_t *snd, int block){
+	if(snd->sampleData){
+		return (char *)snd->sampleData + (long)block * BLOCK_FRAMES * snd->channels * sampleWidth(snd->bitDepth);
+	}
+	
+	const char *error = NULL;
+	const void *data = cachedBlock(sharedCache(), snd, block, &error);
+	if(!data){
+		sndFail(SND_ERR_DATA, "%s\n", error);
+	}
+	return data;
+}
+
+/**
+*	Starts an empty block cache that keeps up to budget bytes of decoded blocks
+*/
+void initCache(blockcache_t *cache, long budget){
+	cache->budget = budget;
+	cache->used = 0;
+	cache->buckets = calloc(CACHE_BUCKETS, sizeof(cacheentry_t *));
+	cache->newest = NULL;
+	cache->oldest = NULL;
+	cache->hits = 0;
+	cache->misses = 0;
+	cache->evictions = 0;
+}
+
+/**
+*	Frees every block in the cache
+*/
+void freeCache(blockcache_t *cache){
+	while(cache->oldest){
+		removeEntry(cache, cache->oldest);
+	}
+	free(cache->buckets);
+	cache->buckets = NULL;
+}
+
+/**
+*	Returns the cache the read paths share, started with CACHE_BUDGET the first time
+*/
+blockcache_t *sharedCache(){
+	static blockcache_t cache;
+	if(!cache.buckets){
+		initCache(&cache, CACHE_BUDGET);
+	}
+	return &cache;
+}
+
+/**
+*	Changes how many bytes the cache keeps, dropping the least recently used blocks past it
+*/
+void setCacheBudget(blockcache_t *cache, long budget){
+	cache->budget = budget;
+	while(cache->oldest && cache->used > cache->budget){
+		removeEntry(cache, cache->oldest);
+		cache->evictions++;
+	}
+}
+
+/**
+*	Returns the data of a block of file if it is in the cache, making it the most recently used
+*/
+void *findBlock(blockcache_t *cache, int file, int block){
+	if(cache->newest && cache->newest->file == file && cache->newest->block == block){ /* samples are mostly read in runs from one block */
+		cache->hits++;
+		return cache->newest->data;
+	}
+	cacheentry_t *entry = cache->buckets[(unsigned)(file * 31 + block) % CACHE_BUCKETS];
+	while(entry && (entry->file != file || entry->block != block)){
+		entry = entry->next;
+	}
+	if(!entry){
+		return NULL;
+	}
+	
+	if(entry != cache->newest){ /* move it to the front of the order */
+		entry->newer->older = entry->older;
+		if(entry->older){
+			entry->older->newer = entry->newer;
+		} else {
+			cache->oldest = entry->newer;
+		}
+		entry->older = cache->newest;
+		entry->newer = NULL;
+		cache->newest->newer = entry;
+		cache->newest = entry;
+	}
+	cache->hits++;
+	return entry->data;
+}
+
+/**
+*	Adds a block of size bytes to the cache as the most recently used, dropping the least recently used
+*	blocks until it fits in the budget. Returns its storage, for the caller to decode into
+*/
+void *addBlock(blockcache_t *cache, int file, int block, long size){
+	while(cache->oldest && cache->used + size > cache->budget){ /* a block bigger than the budget is still kept alone */
+		removeEntry(cache, cache->oldest);
+		cache->evictions++;
+	}
+	
+	cacheentry_t *entry = malloc(sizeof(cacheentry_t));
+	entry->data = malloc(size);
+	if(entry->data == NULL){
+		sndFail(SND_ERR_MEMORY, "error allocating memory for sample data.\n");
+	}
+	entry->file = file;
+	entry->block = block;
+	entry->size = size;
+	
+	cacheentry_t **bucket = &cache->buckets[(unsigned)(file * 31 + block) % CACHE_BUCKETS];
+	entry->next = *bucket;
+	*bucket = entry;
+	entry->newer = NULL;
+	entry->older = cache->newest;
+	if(cache->newest){
+		cache->newest->newer = entry;
+	} else {
+		cache->oldest = entry;
+	}
+	cache->newest = entry;
+	cache->used += size;
+	cache->misses++;
+	return entry->data;
+}
+
+/**
+*	Takes an entry out of its bucket and the order, and frees it
+*/
+void removeEntry(blockcache_t *cache, cacheentry_t *entry){
+	cacheentry_t **link = &cache->buckets[(unsigned)(entry->file * 31 + entry->block) % CACHE_BUCKETS];
+	while(*link != entry){
+		link = &(*link)->next;
+	}
+	*link = entry->next;
+	
+	if(entry->newer){
+		entry->newer->older = entry->older;
+	} else {
+		cache->newest = entry->older;
+	}
+	if(entry->older){
+		entry->older->newer = entry->newer;
+	} else {
+		cache->oldest = entry->newer;
+	}
+	cache->used -= entry->size;
+	free(entry->data);
+	free(entry);
+}
+
+/**
+*	Drops every block of file, once it is closed
+*/
+void dropBlocks(blockcache_t *cache, int file){
+	if(!cache->buckets){
+		return;
+	}
+	cacheentry_t *entry = cache->oldest;
+	while(entry){
+		cacheentry_t *newer = entry->newer;
+		if(entry->file == file){
+			removeEntry(cache, entry);
+		}
+		entry = newer;
+	}
+}
+
+/**
+*	Returns 1 if adding size bytes would drop a block
+*/
+int cacheFull(blockcache_t *cache, long size){
+	return cache->used + size > cache->budget;
+}
+
+/**
+*	Returns a block of snd from the cache, decoding it into the cache first if it is not there.
+*	If it cannot be decoded, error is set to why and NULL is returned
+*/
+const void *cachedBlock(blockcache_t *cache, soundfile_t *snd, int block, const char **error){
+	void *data = findBlock(cache, snd->id, block);
+	if(data){
+		return data;
+	}
+	
+	data = addBlock(cache, snd->id, block, (long)BLOCK_FRAMES * snd->channels * sampleWidth(snd->bitDepth));
+	*error = fillBlock(snd, block, data);
+	if(*error){
+		removeEntry(cache, cache->newest);
+		return NULL;
+	}
+	return data;
+}
+
+/**
+*	Decodes a block of snd's samples into data, from its mapping or from where the block starts in its CS229 data.
+*	Returns what was wrong with the samples, or NULL if nothing was
+*/
+const char *fillBlock(soundfile_t *snd, int block, void *data){
+	if(snd->mapped){
+		int frame = block * BLOCK_FRAMES;
+		int numFrames = (snd->samples - frame < BLOCK_FRAMES) ? snd->samples - frame : BLOCK_FRAMES;
+		decodeFrames(snd, frame, numFrames, data);
+		return NULL;
+	}
+	return fillCs229Block(snd, block, data);
+}
+
+/**
+*	Reads the argument of -m, a positive number of megabytes
+*/
+int parseMegabytes(char *arg){
+	int j;
+	for(j = 0; j < strlen(arg); j++){
+		if(arg[j] < '0' || arg[j] > '9' || atoi(arg) == 0){ /* if not a number or zero*/
+			sndFail(SND_ERR_ARGUMENT, "-m takes a positive number of megabytes\n");
+		}
+	}
+	if(strlen(arg) == 0){
+		sndFail(SND_ERR_ARGUMENT, "-m takes a positive number of megabytes\n");
+	}
+	return atoi(arg);
+}
+
+/**
+*	Stores the value at index of the parsed sample data
+*/
+void setSample(soundfile_t *snd, int index, int value){
+	writeSample(snd->sampleData, sampleWidth(snd->bitDepth), index, value);
+}
+
+/**
+*	Sorts the [low..high] ranges by low and merges the ones that overlap or touch, in place.
+*	Returns the number of ranges left
+*/
+int mergeRanges(int low[], int high[], int numRestrictions){
+	if(numRestrictions <= 0){
+		return 0;
+	}
+	
+	int *ranges = malloc(numRestrictions * 2 * sizeof(int)); /* low and high pairs, sorted together */
+	int i;
+	for(i = 0; i < numRestrictions; i++){
+		ranges[i*2] = low[i];
+		ranges[i*2 + 1] = high[i];
+	}
+	qsort(ranges, numRestrictions, 2 * sizeof(int), compareRanges);
+	
+	int count = 0;
+	for(i = 0; i < numRestrictions; i++){
+		if(count > 0 && ranges[i*2] <= high[count - 1] + 1){ /* overlaps or touches the last range */
+			if(ranges[i*2 + 1] > high[count - 1]){
+				high[count - 1] = ranges[i*2 + 1];
+			}
+		} else {
+			low[count] = ranges[i*2];
+			high[count] = ranges[i*2 + 1];
+			count++;
+		}
+	}
+	free(ranges);
+	return count;
+}
+
+/**
+*	Orders low and high pairs by low, for qsort
+*/
+int compareRanges(const void *a, const void *b){
+	int lowA = ((const int *)a)[0];
+	int lowB = ((const int *)b)[0];
+	return (lowA > lowB) - (lowA < lowB);
+}
+
+/**
+*	Finds the first run of frames in [frame..end) that none of the merged ranges cut.
+*	Returns its first frame, or end if there is none, and sets spanEnd to the frame after it.
+*	range is the first range that may still matter, it starts at 0 and is moved forward as frame is
+*/
+int keptSpan(int frame, int end, int low[], int high[], int numRestrictions, int *range, int *spanEnd){
+	while(*range < numRestrictions && high[*range] < frame){ /* ranges already passed */
+		(*range)++;
+	}
+	if(*range < numRestrictions && low[*range] <= frame){ /* frame is cut, skip to the end of its range */
+		frame = high[*range] + 1;
+	}
+	
+	if(frame >= end){ /* the range may go on into the next call, so it is kept */
+		*spanEnd = end;
+		return end;
+	}
+	
+	while(*range < numRestrictions && high[*range] < frame){
+		(*range)++;
+	}
+	*spanEnd = end;
+	if(*range < numRestrictions && low[*range] < end){ /* merged ranges never touch, so this is after frame */
+		*spanEnd = low[*range];
+	}
+	return frame;
+}
+
+/**
+*	Number of frames of samples that the merged ranges do not cut
+*/
+int keptFrames(int low[], int high[], int numRestrictions, int samples){
+	int kept = samples;
+	int i;
+	for(i = 0; i < numRestrictions && low[i] < samples; i++){
+		int last = (high[i] < samples) ? high[i] : samples - 1;
+		kept -= last - low[i] + 1;
+	}
+	return kept;
+}
+
+/**
+*	Writes value in decimal at to, without a terminating null. Returns the end of what was written
+*/
+char *formatInt(char *to, int value){
+	static const char pairs[] = /* "00" to "99", two digits are done at a time */
+		"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+		"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+		"8081828384858687888990919293949596979899";
+	char digits[10];
+	char *at = digits + 10;
+	unsigned int num = value;
+	
+	if(value < 0){
+		*to++ = '-';
+		num = -num;
+	}
+	while(num >= 100){ /* digits are found backwards */
+		at -= 2;
+		memcpy(at, pairs + (num % 100) * 2, 2);
+		num /= 100;
+	}
+	if(num >= 10){
+		at -= 2;
+		memcpy(at, pairs + num * 2, 2);
+	} else {
+		*--at = '0' + num;
+	}
+	
+	memcpy(to, at, digits + 10 - at);
+	return to + (digits + 10 - at);
+}
+
+/**
+*	Writes the samples of snd, whose stream is just past its format identifier, to the file described by out.
+*	They are read and written BLOCK_FRAMES frames at a time, so the input is never held whole
+*/
+void streamSamples(soundfile_t *snd, soundfile_t *out, FILE *to){
+	soundfile_t writer = *out;
+	writer.stream = to; /* where writeBlock writes */
+	readBlocks(snd, writeBlock, &writer);
+}
+
+/**
+*	Reads the samples of snd, whose stream is just past its format identifier, BLOCK_FRAMES frames at a time.
+*	Each block is passed to use, with arg, stored at the width given by sampleWidth
+*/
+void readBlocks(soundfile_t *snd, void (*use)(void *arg, const void *data, int numFrames), void *arg){
+	void *block = NULL; /* allocated once the header gives the frame size */
+	int frame;
+	
+	if(strcmp(snd->format, "AIFF") == 0){
+		if(mapAiff(snd)){ /* decoded a block at a time from the mapping, it is read once so the cache is not used */
+			block = malloc((long)BLOCK_FRAMES * snd->channels * sampleWidth(snd->bitDepth));
+			for(frame = 0; frame < snd->samples; frame += BLOCK_FRAMES){
+				int numFrames = (snd->samples - frame < BLOCK_FRAMES) ? snd->samples - frame : BLOCK_FRAMES;
+				decodeFrames(snd, frame, numFrames, block);
+				use(arg, block, numFrames);
+			}
+			unmapAiff(snd);
+		} else if(parseAiffChunks(snd, AIFF_STREAM)){
+			block = malloc((long)BLOCK_FRAMES * snd->channels * sampleWidth(snd->bitDepth));
+			for(frame = 0; frame < snd->samples; frame += BLOCK_FRAMES){
+				int numFrames = (snd->samples - frame < BLOCK_FRAMES) ? snd->samples - frame : BLOCK_FRAMES;
+				readAiffFrames(snd, block, numFrames);
+				use(arg, block, numFrames);
+			}
+		} else { /* COMM came after SSND, so the file was parsed whole */
+			use(arg, snd->sampleData, snd->samples);
+			free(snd->sampleData);
+		}
+	
+	} else if(strcmp(snd->format, "CS229B") == 0){ /* mapped, or decoded in one go, so it is used whole */
+		parseCs229b(snd);
+		if(snd->samples > 0){
+			use(arg, snd->sampleData, snd->samples);
+		}
+		freeCs229b(snd);
+	
+	} else {
+		parseHeader(snd);
+		block = malloc((long)BLOCK_FRAMES * snd->channels * sampleWidth(snd->bitDepth));
+		tokenizer_t tok;
+		initTokenizer(&tok, snd->stream);
+		int found = 0;
+		int numFrames;
+		long long value;
+		do {
+			numFrames = BLOCK_FRAMES;
+			if(snd->samples > 0 && snd->samples - found < BLOCK_FRAMES){ /* stop at the specified number */
+				numFrames = snd->samples - found;
+			}
+			numFrames = readCs229Frames(&tok, snd, block, numFrames);
+			if(numFrames > 0){
+				use(arg, block, numFrames);
+			}
+			found += numFrames;
+		} while(numFrames == BLOCK_FRAMES);
+		
+		if(snd->samples > 0 && (found < snd->samples || nextInt(&tok, &value) != EOF)){
+			sndFail(SND_ERR_DATA, "specified number of samples, %d, did not match read number of samples\n", snd->samples);
+		}
+		freeTokenizer(&tok);
+	}
+	free(block);
+}
+
+/**
+*	Writes a block from readBlocks to the stream of the soundfile_t arg, in its format
+*/
+void writeBlock(void *arg, const void *data, int numFrames){
+	soundfile_t *out = arg;
+	writeFrames(out, data, numFrames, out->stream);
+}
+
+/**
+*	Writes numFrames frames of sample data in the format of out
+*/
+void writeFrames(soundfile_t *out, const void *data, int numFrames, FILE *to){
+	if(strcmp(out->format, "AIFF") == 0){
+		writeAiffFrames(out, data, numFrames, to);
+	} else if(strcmp(out->format, "CS229B") == 0){
+		writeCs229bFrames(out, data, numFrames, NULL, to);
+	} else {
+		writeCs229Frames(out, data, numFrames, to);
+	}
+}
+
+/**
+*	Skips over numBytes of the stream, reading past them if the stream cannot seek
+*/
+void skipBytes(FILE *stream, long numBytes){
+	struct stat info;
+	if(numBytes <= 0){
+		return;
+	}
+	
+	if(fseek(stream, numBytes, SEEK_CUR) == 0){ /* seeking past the end does not fail, so check the size */
+		if(fstat(fileno(stream), &info) == 0 && S_ISREG(info.st_mode) && ftell(stream) > info.st_size){
+			sndFail(SND_ERR_DATA, "found end of file before was specified\n");
+		}
+		return;
+	}
+	
+	char discard[4096]; /* stdin may be a pipe, so read and throw away */
+	while(numBytes > 0){
+		size_t chunk = numBytes < sizeof(discard) ? numBytes : sizeof(discard);
+		if(fread(discard, 1, chunk, stream) != chunk){
+			sndFail(SND_ERR_DATA, "found end of file before was specified\n");
+		}
+		numBytes -= chunk;
+	}
 }
 
 /**
@@ -249,16 +1073,17 @@ void basicSndinfo(){
 	snd.stream = fopen(snd.name, "r"); /* open file as read only */
 	
 	if(!snd.stream){ /* invalid file pointer */
-		fprintf(stderr, "Error: no such file\n");
-		exit(EXIT_FAILURE);
+		sndFail(SND_ERR_IO, "no such file\n");
 	}
 	
 	/* valid file pointer */
 	setFormat(&snd);
 	if(strcmp(snd.format, "CS229") == 0){
-		parseCs229(&snd);
+		probeCs229(&snd);
+	} else if(strcmp(snd.format, "CS229B") == 0){
+		probeCs229b(&snd);
 	} else {
-		parseAiff(&snd);
+		probeAiff(&snd);
 	}
 	
 	fclose(snd.stream); /* close file after parsing */
@@ -283,13 +1108,14 @@ void basicSndconv(){
 	}
 	from.stream = fopen(from.name, "r"); /* open file as read only */
 	if(!from.stream){ /* invalid file pointer */
-		fprintf(stderr, "Error: no such file\n");
-		exit(EXIT_FAILURE);
+		sndFail(SND_ERR_IO, "no such file\n");
 	}
 	setFormat(&from); /* should throw error if not CS229 or AIFF */
 
 	if(strcmp(from.format, "CS229") == 0){
 		parseCs229(&from);
+	} else if(strcmp(from.format, "CS229B") == 0){
+		parseCs229b(&from);
 	} else {
 		parseAiff(&from);
 	}
@@ -304,15 +1130,220 @@ void basicSndconv(){
 	
 	FILE* to = fopen(name, "w"); /* make file of opposing format */
 	if(!to){ /* invalid file pointer */
-		fprintf(stderr, "Error: could not open file for writing\n");
-		exit(EXIT_FAILURE);
+		sndFail(SND_ERR_IO, "could not open file for writing\n");
 	}
 	
-	if(strcmp(from.format, "CS229") == 0){
+	if(strncmp(from.format, "CS229", 5) == 0){ /* CS229 and CS229B are written as AIFF */
 		writeAiff(&from, to);
 	} else {
 		writeCs229(&from, to);
 	}
 	
 	fclose(to);
-}
\ No newline at end of file
+}
+
+/**
+*	Turns on --stats if it is among the arguments, and takes it out of them so the programs read the rest as before.
+*	Returns the new argc. The report is printed to standard error at exit, so it covers every way a program can end
+*/
+int statsSwitch(int argc, char *argv[]){
+	int kept = 1;
+	int i;
+	for(i = 1; i < argc; i++){
+		if(strcmp(argv[i], "--stats") != 0){
+			argv[kept++] = argv[i];
+		} else if(!stats.on){
+			stats.on = 1;
+			stats.current = -1;
+			statsTimes(&stats.started, &stats.cpuStarted);
+			stats.wallAt = stats.started;
+			stats.cpuAt = stats.cpuStarted;
+			if(!readIoCounts(&stats.readAt, &stats.wroteAt)){
+				stats.readAt = -1;
+			}
+			atexit(printStats);
+		}
+	}
+	argv[kept] = NULL;
+	return kept;
+}
+
+/**
+*	Ends the phase being timed and starts timing name, or nothing if name is NULL.
+*	Entering a phase again adds to its time
+*/
+void statsPhase(const char *name){
+	if(!stats.on){
+		return;
+	}
+	double wall;
+	double cpu;
+	statsTimes(&wall, &cpu);
+	if(stats.current >= 0){
+		stats.phases[stats.current].wall += wall - stats.wallAt;
+		stats.phases[stats.current].cpu += cpu - stats.cpuAt;
+	}
+	stats.wallAt = wall;
+	stats.cpuAt = cpu;
+	stats.current = -1;
+	if(!name){
+		return;
+	}
+	
+	int i;
+	for(i = 0; i < stats.numPhases; i++){
+		if(strcmp(stats.phases[i].name, name) == 0){
+			stats.current = i;
+		}
+	}
+	if(stats.current == -1 && stats.numPhases < MAX_PHASES){ /* a new phase, past MAX_PHASES it is not timed */
+		stats.current = stats.numPhases++;
+		stats.phases[stats.current].name = name;
+		stats.phases[stats.current].wall = 0;
+		stats.phases[stats.current].cpu = 0;
+	}
+}
+
+/**
+*	Adds to the sample frames read. The worker threads of sndconv -r and sndcat -j add at once
+*/
+void statsFrames(long frames){
+	__atomic_add_fetch(&stats.frames, frames, __ATOMIC_RELAXED);
+}
+
+/**
+*	Adds to the bytes of input read through a memory mapping, also from more than one thread
+*/
+void statsMapped(long bytes){
+	__atomic_add_fetch(&stats.mapped, bytes, __ATOMIC_RELAXED);
+}
+
+/**
+*	The wall clock, and the user and system CPU time of every thread so far, in seconds
+*/
+void statsTimes(double *wall, double *cpu){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	*wall = ts.tv_sec + ts.tv_nsec / 1e9;
+	
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	*cpu = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+/**
+*	Reads the bytes passed to read and write calls so far from /proc/self/io, returns 0 if it cannot
+*/
+int readIoCounts(long *read, long *wrote){
+	FILE *io = fopen("/proc/self/io", "r");
+	if(!io){
+		return 0;
+	}
+	char key[32];
+	long value;
+	int found = 0;
+	while(fscanf(io, "%31s %ld", key, &value) == 2){
+		if(strcmp(key, "rchar:") == 0){
+			*read = value;
+			found++;
+		} else if(strcmp(key, "wchar:") == 0){
+			*wrote = value;
+			found++;
+		}
+	}
+	fclose(io);
+	return found == 2;
+}
+
+/**
+*	Prints the --stats report to standard error: the wall and CPU time of each phase, the bytes read and
+*	written, the frames read, the throughput, the allocations and the peak resident set size.
+*	Each line is "stats:" followed by key=value pairs, so logs can be searched for them
+*/
+void printStats(){
+	fflush(stdout); /* so what is still buffered counts as written */
+	statsPhase(NULL);
+	double wall;
+	double cpu;
+	statsTimes(&wall, &cpu);
+	wall -= stats.started;
+	cpu -= stats.cpuStarted;
+	
+	int i;
+	for(i = 0; i < stats.numPhases; i++){
+		fprintf(stderr, "stats: phase=%s wall=%.6f cpu=%.6f\n", stats.phases[i].name, stats.phases[i].wall, stats.phases[i].cpu);
+	}
+	
+	long read;
+	long wrote;
+	if(stats.readAt >= 0 && readIoCounts(&read, &wrote)){
+		read = read - stats.readAt + stats.mapped;
+		wrote -= stats.wroteAt;
+		fprintf(stderr, "stats: read_bytes=%ld written_bytes=%ld read_mb_s=%.1f written_mb_s=%.1f\n", read, wrote,
+			read / wall / (1024 * 1024), wrote / wall / (1024 * 1024));
+	}
+	
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	fprintf(stderr, "stats: total wall=%.6f cpu=%.6f frames=%ld frames_s=%.0f allocations=%ld allocated_bytes=%ld peak_rss_kb=%ld\n",
+		wall, cpu, stats.frames, stats.frames / wall, stats.allocations, stats.allocated, usage.ru_maxrss);
+}
+
+/**
+*	Reports an error. In the programs, "Error: " and the message are printed to out and the program exits.
+*	While a library call is running, the message is kept in its context and the call returns code instead
+*/
+void failWith(FILE *out, int code, const char *format, va_list args){
+	sndcontext_t *context = activeContext;
+	if(!context){
+		fprintf(out, "Error: ");
+		vfprintf(out, format, args);
+		exit(EXIT_FAILURE);
+	}
+	int length = vsnprintf(context->message, MAX_ERROR_LENGTH, format, args); /* may hold a '\0' printed with %c */
+	if(length > MAX_ERROR_LENGTH - 1){
+		length = MAX_ERROR_LENGTH - 1;
+	}
+	context->newline = (length > 0 && context->message[length - 1] == '\n');
+	if(context->newline){
+		context->message[--length] = '\0';
+	}
+	context->length = length;
+	context->out = out;
+	longjmp(context->jump, code);
+}
+
+/**
+*	Reports an error with failWith, the programs print it to standard error
+*/
+void sndFail(int code, const char *format, ...){
+	va_list args;
+	va_start(args, format);
+	failWith(stderr, code, format, args);
+}
+
+/**
+*	Reports an error with failWith, the programs print it to out
+*/
+void sndFailTo(FILE *out, int code, const char *format, ...){
+	va_list args;
+	va_start(args, format);
+	failWith(out, code, format, args);
+}
+
+/**
+*	Makes context the active one on this thread, so allocations come from it and errors return to its jump.
+*	The caller must have set the jump with setjmp
+*/
+void enterContext(sndcontext_t *context){
+	context->previous = activeContext;
+	activeContext = context;
+}
+
+/**
+*	Makes the context that was active before enterContext active again
+*/
+void leaveContext(sndcontext_t *context){
+	activeContext = context->previous;
+	context->previous = NULL;
+}
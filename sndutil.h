@@ -6,15 +6,26 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include "libsnd.h"
 
 #define MAX_NAME_LENGTH 256
 #define MIN_COLS 40
 #define MIN_ROWS 24
- 
+#define BLOCK_FRAMES 4096 /* frames decoded at a time from a mapped or indexed file */
+#define WRITE_BLOCK 65536 /* bytes the writers fill before writing */
+#define PEAK_BASE 16 /* frames summarized by each node of the lowest pyramid level */
+#define CACHE_BUDGET (16L * 1024 * 1024) /* default bytes of decoded blocks the block cache keeps */
+#define CACHE_BUCKETS 1024 /* hash buckets of the block cache */
+#define MAX_PHASES 16 /* phases --stats keeps apart */
+#define MAX_ERROR_LENGTH 512 /* chars of an error message a handle keeps */
+#define ALLOCATION_HEADER ((sizeof(allocation_t) + 15) & ~15L) /* bytes before it, so the memory stays aligned for any type */
+
 typedef struct {
 	FILE *stream; /* the file being read */
 	char name[MAX_NAME_LENGTH]; /* file location */
-	char format[6]; /* CS229 or AIFF */
+	char format[8]; /* CS229, CS229B or AIFF */
 	int samples; /* number of samples */
 	unsigned long sampleRate; /* samples per second */
 	int bitDepth; /* 8, 16, or 32 */
@@ -23,19 +34,187 @@ typedef struct {
 	int offset;
 	int blockSize;
 	int numBytes; /* size of sample data */
-	int *sampleData; /* stores the sample data*/
+	void *sampleData; /* stores the sample data at the width given by sampleWidth */
+	long dataStart; /* file position of the AIFF sample data */
+	unsigned char *mapped; /* memory mapped file, NULL if the data was parsed */
+	size_t mappedSize;
+	unsigned char *ssnd; /* big-endian sample data inside the mapping */
+	long *offsets; /* stream position of each block of CS229 sample data, as far as it has been read */
+	int numOffsets;
+	void *reader; /* tokenizer left just past the last CS229 block parsed, so the block after it does not seek */
+	int readerBlock;
+	int id; /* identifies the sound's blocks in a block cache, copies of it share them */
+	int coding; /* how the samples of a CS229B file are stored, one of the SND_CODING values */
+	int byteSwapped; /* 1 if the raw samples of a CS229B file are in the other byte order */
 } soundfile_t;
 
+typedef struct cacheentry {
+	int file; /* id of the sound the block is from */
+	int block;
+	void *data; /* the decoded frames, stored like sampleData */
+	long size;
+	struct cacheentry *next; /* next entry in the same bucket */
+	struct cacheentry *newer; /* neighbours in the order they were last used */
+	struct cacheentry *older;
+} cacheentry_t;
+
+typedef struct {
+	long budget; /* bytes of decoded data it keeps, the least recently used blocks are dropped past it */
+	long used;
+	cacheentry_t **buckets; /* entries hashed by file and block */
+	cacheentry_t *newest;
+	cacheentry_t *oldest;
+	long hits; /* lookups that found their block */
+	long misses; /* blocks that had to be decoded */
+	long evictions;
+} blockcache_t;
+
+typedef struct {
+	const char *name;
+	double wall; /* seconds spent in the phase */
+	double cpu; /* user and system seconds of every thread while in it */
+} phase_t;
+
+typedef struct {
+	int on; /* set by --stats */
+	phase_t phases[MAX_PHASES]; /* in the order they were first entered */
+	int numPhases;
+	int current; /* phase being timed, -1 before the first */
+	double started; /* wall clock and CPU time when --stats was seen */
+	double cpuStarted;
+	double wallAt; /* wall and CPU time when the current phase was entered */
+	double cpuAt;
+	long readAt; /* rchar and wchar of /proc/self/io when --stats was seen, -1 if it cannot be read */
+	long wroteAt;
+	long mapped; /* bytes of input read through a memory mapping, which rchar does not count */
+	long frames; /* sample frames read */
+	long allocations; /* calls to malloc, calloc and realloc */
+	long allocated; /* bytes they asked for */
+} stats_t;
+
+typedef struct allocation {
+	struct allocation *newer; /* neighbours in the list of what the context has allocated */
+	struct allocation *older;
+	struct sndcontext *context; /* the context it was allocated for */
+	size_t size; /* bytes asked for, not counting the header */
+} allocation_t;
+
+typedef struct sndcontext {
+	sndallocator_t allocator; /* where the memory allocated while the context is active comes from */
+	allocation_t *newest; /* everything allocated for the context, newest first */
+	jmp_buf jump; /* where sndFail returns to while the context is active */
+	struct sndcontext *previous; /* the context that was active when this one was entered */
+	char message[MAX_ERROR_LENGTH]; /* the last error, without its trailing newline */
+	int length; /* chars in message */
+	FILE *out; /* where the programs print it, a few errors have always gone to standard output */
+	int newline; /* 1 if the message ended in a newline */
+} sndcontext_t;
+
+extern stats_t stats; /* what --stats reports, counted by the allocation hooks too */
+extern __thread sndcontext_t *activeContext; /* the context of the library call running on this thread, NULL in the programs */
+
+typedef struct {
+	int32_t min;
+	int32_t max;
+	int32_t peak; /* the first value of the greatest magnitude, what zoomSample returns */
+} peak_t;
+
+typedef struct {
+	peak_t **levels; /* levels[k] has a peak_t per channel for every PEAK_BASE << k frames */
+	int *numNodes; /* nodes in each level */
+	int numLevels;
+	int channels;
+} pyramid_t;
+
+typedef struct {
+	int bitDepth; /* what the table was built for */
+	int w;
+	int avalible; /* chars on each side of the 0 pipe */
+	int max; /* maximum possible value for the bit depth */
+	int maxDashes; /* dashes of the largest magnitude, the most negative value can pass avalible */
+	long long *thresholds; /* smallest magnitude drawn with d dashes, for d = 0..maxDashes */
+	char *bars; /* every bar, each ending with "|\n" */
+	int *offsets; /* where the bar of d dashes starts in bars, at 2*d for a negative value and 2*d + 1 for a positive one */
+	int *lengths; /* chars in each bar, indexed like offsets */
+} bartable_t;
+
+typedef struct {
+	soundfile_t *snd; /* the header is filled in by readBlocks before the first block */
+	int n; /* frames per line */
+	int c; /* channel shown, -1 for all */
+	int w; /* total output width */
+	int line; /* number of the line being gathered */
+	int inLine; /* frames of that line seen so far */
+	int *peaks; /* first value of the greatest magnitude of each channel over the line so far */
+} showstate_t;
+
 /* General Code Functions */
-void printDisplayed(int value, int bitDepth, int w);
+bartable_t *barTable(int bitDepth, int w);
+int floatDashes(long long magnitude, int max, int avalible);
+int barDashes(bartable_t *table, long long magnitude);
+const char *barFor(int value, int bitDepth, int w, int *length);
 void initSoundfile(soundfile_t *snd);
 void keywordsAreSet(soundfile_t *snd);
+void writeSndInfo(soundfile_t *snd, FILE *to);
 void printSndInfo(soundfile_t *snd);
-void printDisplayed(int displayed, int max, int w);
 void setFormat(soundfile_t *snd);
 void dataCut(int low[], int high[], int numRestrictions, soundfile_t *snd);
-void dataCat(int insertSample, int *insertBuffer, int bufferSize, soundfile_t *snd);
-int zoomSample(int index, int n, soundfile_t *snd);
+void dataCat(int insertSample, void *insertBuffer, int bufferSize, soundfile_t *snd);
+int zoomSample(int frame, int channel, int n, soundfile_t *snd);
+void buildPyramid(pyramid_t *pyramid, soundfile_t *snd);
+void freePyramid(pyramid_t *pyramid);
+peak_t combinePeaks(peak_t first, peak_t second);
+peak_t pyramidPeak(pyramid_t *pyramid, soundfile_t *snd, int channel, int frame, int end);
+void printShowLine(int line, int values[], int channels, int c, int bitDepth, int w);
+void showBlock(void *arg, const void *data, int numFrames);
+void finishShow(showstate_t *show);
+int sampleWidth(int bitDepth);
+int readSample(const void *data, int width, int index);
+void writeSample(void *data, int width, int index, int value);
+int getSample(soundfile_t *snd, int index);
+void setSample(soundfile_t *snd, int index, int value);
+const void *frameBlock(soundfile_t *snd, int block);
+
+/* Block Cache Functions */
+void initCache(blockcache_t *cache, long budget);
+void freeCache(blockcache_t *cache);
+blockcache_t *sharedCache();
+void setCacheBudget(blockcache_t *cache, long budget);
+void *findBlock(blockcache_t *cache, int file, int block);
+void *addBlock(blockcache_t *cache, int file, int block, long size);
+void removeEntry(blockcache_t *cache, cacheentry_t *entry);
+void dropBlocks(blockcache_t *cache, int file);
+int cacheFull(blockcache_t *cache, long size);
+const void *cachedBlock(blockcache_t *cache, soundfile_t *snd, int block, const char **error);
+const char *fillBlock(soundfile_t *snd, int block, void *data);
+int parseMegabytes(char *arg);
+
+/* Library Context Functions */
+void sndFail(int code, const char *format, ...);
+void sndFailTo(FILE *out, int code, const char *format, ...);
+void enterContext(sndcontext_t *context);
+void leaveContext(sndcontext_t *context);
+soundfile_t *handleSound(sndhandle_t *handle);
+
+/* Stats Functions */
+int statsSwitch(int argc, char *argv[]);
+void statsPhase(const char *name);
+void statsFrames(long frames);
+void statsMapped(long bytes);
+void statsTimes(double *wall, double *cpu);
+int readIoCounts(long *read, long *wrote);
+void printStats();
+
+char *formatInt(char *to, int value);
+int mergeRanges(int low[], int high[], int numRestrictions);
+int compareRanges(const void *a, const void *b);
+int keptSpan(int frame, int end, int low[], int high[], int numRestrictions, int *range, int *spanEnd);
+int keptFrames(int low[], int high[], int numRestrictions, int samples);
+void streamSamples(soundfile_t *snd, soundfile_t *out, FILE *to);
+void readBlocks(soundfile_t *snd, void (*use)(void *arg, const void *data, int numFrames), void *arg);
+void writeBlock(void *arg, const void *data, int numFrames);
+void writeFrames(soundfile_t *out, const void *data, int numFrames, FILE *to);
+void skipBytes(FILE *stream, long numBytes);
 int power(int num, int exp);
 void basicSndinfo();
 void basicSndconv();